@@ -27,23 +27,71 @@ SOFTWARE.
 #include <vector>
 #include <array>
 #include <fstream>
-#include <sstream>
 #include <limits>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <type_traits>
 
-template <typename T>
+// define TINY_LDT_NO_MMAP to always read files through a buffered std::ifstream and write them through stdio
+#if !defined(TINY_LDT_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define TINY_LDT_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+// define TINY_LDT_NO_SIMD to disable the SSE2/AVX2 line scanning
+#if !defined(TINY_LDT_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define TINY_LDT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TINY_LDT_TARGET_AVX2
+#else
+#define TINY_LDT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Alloc is used, rebound, for every string and vector inside light, e.g. to keep all lights of a scene in one arena
+template <typename T, typename Alloc = std::allocator<T>>
 struct tiny_ldt {
     static_assert(std::is_floating_point<T>::value, "T must be floating point");
+    typedef Alloc allocator_type;
+    typedef std::basic_string<char, std::char_traits<char>, typename std::allocator_traits<Alloc>::template rebind_alloc<char>> string_type;
+    template <typename V>
+    using vector_type = std::vector<V, typename std::allocator_traits<Alloc>::template rebind_alloc<V>>;
+
     // https://docs.agi32.com/PhotometricToolbox/Content/Open_Tool/eulumdat_file_format.htm
     // https://web.archive.org/web/20190717124121/http://www.helios32.com/Eulumdat.htm
     // https://de.wikipedia.org/wiki/EULUMDAT
     struct light {
-        light() :
+        explicit light(const Alloc& alloc = Alloc()) :
+            manufacturer(alloc),
     		ltyp{},
             lsym{},
             mc{}, mc1{}, mc2{},
             dc{},
             ng{},
             dg{},
+            measurement_report_number(alloc),
+            luminaire_name(alloc),
+            luminaire_number(alloc),
+            file_name(alloc),
+            date_user(alloc),
             height_luminaire{},
             length_luminaire{},
             width_luminaire{},
@@ -56,10 +104,16 @@ struct tiny_ldt {
             dff{}, lorl{},
             conversion_factor{}, tilt_of_luminaire{},
             n{},
-            dr{}
+            lamp_data(alloc),
+            dr{},
+            angles_c(alloc),
+            angles_g(alloc),
+            luminous_intensity_distribution(alloc)
         {}
 
-        std::string manufacturer;   /* Company identification/databank/version/format identification */
+        allocator_type get_allocator() const { return allocator_type(angles_c.get_allocator()); }
+
+        string_type manufacturer;   /* Company identification/databank/version/format identification */
         uint32_t ltyp;              /* Type indicator (0 - point source with no symmetry; 1 - symmetry  about the vertical axis; 2 - linear luminaire; 3 - point source with any other symmetry. Note: only linear luminaires, Ityp = 2, are being subdivided in longitudinal and transverse directions) */
         uint32_t lsym;              /* Symmetry indicator (0 ... no symmetry; 1 - symmetry about the vertical axis; 2 - symmetry to plane C0-C180; 3 - symmetry to plane C90-C270; 4 - symmetry to plane C0-C180 and to plane C90-C270) */
         uint32_t mc, mc1, mc2;      /* Number of C-planes between 0 and 360 degrees (usually 24 for interior, 36 for road lighting luminaires) */
@@ -67,11 +121,11 @@ struct tiny_ldt {
         uint32_t ng;                /* Number of luminous intensities in each C-plane (usually 19 or 37) */
         T dg;                       /* Distance between luminous intensities per C-plane (Dg = 0 for non-equidistantly available luminous intensities in C-planes) */
 
-        std::string measurement_report_number;
-        std::string luminaire_name;
-        std::string luminaire_number;
-        std::string file_name;
-        std::string date_user;
+        string_type measurement_report_number;
+        string_type luminaire_name;
+        string_type luminaire_number;
+        string_type file_name;
+        string_type date_user;
 
         uint32_t height_luminaire;          /* mm */
         uint32_t length_luminaire;          /* mm */
@@ -91,8 +145,9 @@ struct tiny_ldt {
         uint32_t n;
 
         struct lamp_data_s {
-            lamp_data_s() :
+            explicit lamp_data_s(const Alloc& alloc = Alloc()) :
                 number_of_lamps{},
+                type_of_lamps(alloc),
                 total_luminous_flux{},
                 color_temperature{},
                 color_rendering_group{},
@@ -100,194 +155,2695 @@ struct tiny_ldt {
             {}
 
             int number_of_lamps; // negative sign indicates absolute photometry
-            std::string type_of_lamps;
+            string_type type_of_lamps;
             uint32_t total_luminous_flux;   /* lm */
             uint32_t color_temperature;
             uint32_t color_rendering_group;
             T watt;                         /* W */
         };
-        std::vector<lamp_data_s> lamp_data;
+        vector_type<lamp_data_s> lamp_data;
 
         std::array<T, 10> dr;
-        std::vector<T> angles_c;
-        std::vector<T> angles_g;
-        std::vector<T> luminous_intensity_distribution; /* cd/1000 lumens */
+        vector_type<T> angles_c;
+        vector_type<T> angles_g;
+        vector_type<T> luminous_intensity_distribution; /* cd/1000 lumens */
+    };
+
+    // new lamp sets get the allocator of the light, resize would need a default constructible allocator
+    static void resize_lamp_data(light& l, const size_t n) {
+        if (n < l.lamp_data.size()) l.lamp_data.erase(l.lamp_data.begin() + static_cast<std::ptrdiff_t>(n), l.lamp_data.end());
+        l.lamp_data.reserve(n);
+        while (l.lamp_data.size() < n) l.lamp_data.emplace_back(l.get_allocator());
+    }
+
+    // resets all fields of l in place, strings and vectors keep their capacity for the next load
+    // lamp sets stay allocated (with cleared contents) until the next load resizes them
+    static void clear(light& l) {
+        l.manufacturer.clear();
+        l.ltyp = 0;
+        l.lsym = 0;
+        l.mc = l.mc1 = l.mc2 = 0;
+        l.dc = 0;
+        l.ng = 0;
+        l.dg = 0;
+        l.measurement_report_number.clear();
+        l.luminaire_name.clear();
+        l.luminaire_number.clear();
+        l.file_name.clear();
+        l.date_user.clear();
+        l.height_luminaire = l.length_luminaire = l.width_luminaire = 0;
+        l.length_luminous_area = l.width_luminous_area = 0;
+        l.height_luminous_area_c0 = l.height_luminous_area_c90 = l.height_luminous_area_c180 = l.height_luminous_area_c270 = 0;
+        l.dff = l.lorl = 0;
+        l.conversion_factor = 0;
+        l.tilt_of_luminaire = 0;
+        l.n = 0;
+        for (auto& ld : l.lamp_data) {
+            ld.number_of_lamps = 0;
+            ld.type_of_lamps.clear();
+            ld.total_luminous_flux = ld.color_temperature = ld.color_rendering_group = 0;
+            ld.watt = 0;
+        }
+        l.dr.fill(0);
+        l.angles_c.clear();
+        l.angles_g.clear();
+        l.luminous_intensity_distribution.clear();
+    }
+
+    // the eulumdat line sequence, in file order
+    enum field : uint8_t {
+        field_manufacturer,                     /* line  1 */
+        field_ltyp,                             /* line  2 */
+        field_lsym,                             /* line  3 */
+        field_mc,                               /* line  4 */
+        field_dc,                               /* line  5 */
+        field_ng,                               /* line  6 */
+        field_dg,                               /* line  7 */
+        field_measurement_report_number,        /* line  8 */
+        field_luminaire_name,                   /* line  9 */
+        field_luminaire_number,                 /* line 10 */
+        field_file_name,                        /* line 11 */
+        field_date_user,                        /* line 12 */
+        field_length_luminaire,                 /* line 13 */
+        field_width_luminaire,                  /* line 14 */
+        field_height_luminaire,                 /* line 15 */
+        field_length_luminous_area,             /* line 16 */
+        field_width_luminous_area,              /* line 17 */
+        field_height_luminous_area_c0,          /* line 18 */
+        field_height_luminous_area_c90,         /* line 19 */
+        field_height_luminous_area_c180,        /* line 20 */
+        field_height_luminous_area_c270,        /* line 21 */
+        field_dff,                              /* line 22 */
+        field_lorl,                             /* line 23 */
+        field_conversion_factor,                /* line 24 */
+        field_tilt_of_luminaire,                /* line 25 */
+        field_n,                                /* line 26 */
+        field_number_of_lamps,                  /* line 26a, n times */
+        field_type_of_lamps,                    /* line 26b, n times */
+        field_total_luminous_flux,              /* line 26c, n times */
+        field_color_temperature,                /* line 26d, n times */
+        field_color_rendering_group,            /* line 26e, n times */
+        field_watt,                             /* line 26f, n times */
+        field_dr,                               /* line 27, 10 times */
+        field_angles_c,                         /* line 28, mc times */
+        field_angles_g,                         /* line 29, ng times */
+        field_luminous_intensity_distribution,  /* line 30, (mc2 - mc1 + 1) * ng times */
+        field_end
+    };
+
+    static const char* field_name(const field f) {
+        static const char* const names[] = { "Manufacturer", "Type", "Symmetry", "Mc", "Dc", "Ng", "Dg",
+            "Measurement report number", "Luminaire name", "Luminaire number", "File name", "Date/user",
+            "Length/diameter of luminaire", "Width of luminaire", "Height of luminaire",
+            "Length/diameter of luminous area", "Width of luminous area",
+            "Height of luminous area C0-plane", "Height of luminous area C90-plane", "Height of luminous area C180-plane", "Height of luminous area C270-plane",
+            "Downward flux fraction", "Light output ratio luminaire", "Conversion factor for luminous intensities",
+            "Tilt of luminaire during measurement", "Number of standard sets of lamps",
+            "Number of lamps", "Type of lamps", "Total luminous flux", "Color appearance", "Color rendering group", "Wattage including ballast",
+            "Direct ratios for room indices k = 0.6 ... 5", "Angles C", "Angles G", "Luminous intensity distribution", "End of file" };
+        return names[f];
+    }
+
+    // position in the line sequence, index counts the lines of repeated fields (lamp sets, direct ratios, angles, intensities)
+    struct field_cursor {
+        field_cursor() : f(field_manufacturer), index(0) {}
+        field f;
+        size_t index;
+    };
+
+    enum severity : uint8_t { severity_warning, severity_error };
+
+    enum diagnostic_code : uint8_t {
+        // warnings, the field keeps its default value
+        diagnostic_invalid_value,
+        diagnostic_out_of_range,
+        // errors, loading stops
+        diagnostic_missing_line,
+        diagnostic_invalid_symmetry,
+        diagnostic_limit_exceeded,
+        diagnostic_input_too_short,
+        diagnostic_input_too_large,
+        diagnostic_invalid_offset,
+        diagnostic_read_failed
+    };
+
+    // a parse problem, recorded without building any strings. use format_diagnostic to get a readable message
+    struct diagnostic {
+        diagnostic() : offset(0), line(0), field_id(field_end), severity(severity_warning), code(diagnostic_invalid_value) {}
+
+        size_t offset;              /* byte offset in the input where the problem was found */
+        uint32_t line;              /* 1 based line number in the file, 0 if the input could not be read */
+        field field_id;
+        tiny_ldt::severity severity;
+        diagnostic_code code;
+    };
+
+    static std::string diagnostic_message(const diagnostic& d) {
+        const std::string name = field_name(d.field_id);
+        switch (d.code) {
+        case diagnostic_invalid_value: return "Value of <" + name + "> could not be read";
+        case diagnostic_out_of_range: return "Value of <" + name + "> is out of range";
+        case diagnostic_missing_line: return "Error reading <" + name + "> property";
+        case diagnostic_invalid_symmetry: return "Error reading light symmetry";
+        case diagnostic_limit_exceeded: return "<" + name + "> exceeds the limit";
+        case diagnostic_input_too_short: return "<" + name + "> exceeds the input size";
+        case diagnostic_input_too_large: return "Input exceeds the size limit";
+        case diagnostic_invalid_offset: return "Invalid data offset";
+        case diagnostic_read_failed: return "Failed reading file";
+        }
+        return "Unknown problem";
+    }
+
+    // e.g. "lamp.ldt:5 (byte 61): warning: Value of <Dc> could not be read"
+    static std::string format_diagnostic(const diagnostic& d, const std::string& source) {
+        return source + ":" + std::to_string(d.line) + " (byte " + std::to_string(d.offset) + "): " +
+            (d.severity == severity_error ? "error: " : "warning: ") + diagnostic_message(d);
+    }
+
+    // read only view of a whole file, memory mapped where supported (see TINY_LDT_MMAP) and read into a buffer otherwise
+    class mapped_file {
+    public:
+        mapped_file() : data_(nullptr), size_(0), mapped_(false) {}
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        ~mapped_file() { close(); }
+
+        bool open(const std::string& filename) {
+            close();
+#ifdef TINY_LDT_MMAP
+            // directories, fifos and devices have no size to read, checked before open which blocks on a fifo
+            struct stat st;
+            if (::stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                size_ = static_cast<size_t>(st.st_size);
+                void* p = size_ ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+                if (p != MAP_FAILED) {
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+                    data_ = static_cast<const char*>(p);
+                    mapped_ = true;
+                }
+            }
+            ::close(fd);
+            if (mapped_) return true;
+#endif
+            // buffered fallback, also used for empty files and anything that cannot be mapped
+            std::ifstream f(filename, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!f) return false;
+            // directories report -1 or a bogus size depending on the file system, but reading them fails right away
+            const std::streamoff size = f.tellg();
+            f.seekg(0);
+            if (size < 0 || (size > 0 && f.peek() == std::ifstream::traits_type::eof())) return false;
+            buffer_.resize(static_cast<size_t>(size));
+            if (!f.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()))) return false;
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+            return true;
+        }
+
+        void close() {
+#ifdef TINY_LDT_MMAP
+            if (mapped_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+            mapped_ = false;
+            buffer_.clear();
+        }
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool mapped() const { return mapped_; }
+
+    private:
+        const char* data_;
+        size_t size_;
+        bool mapped_;
+        std::vector<char> buffer_;
+    };
+
+    // upper bounds for untrusted input, checked before anything is allocated for the declared counts.
+    // loading from a file or buffer also fails if the counts need more lines than bytes are left
+    struct load_limits {
+        load_limits() :
+            max_c_planes(3600),
+            max_gamma_angles(3600),
+            max_lamp_sets(256),
+            max_total_bytes(size_t(256) << 20)
+        {}
+
+        uint32_t max_c_planes;      /* mc */
+        uint32_t max_gamma_angles;  /* ng */
+        uint32_t max_lamp_sets;     /* n */
+        size_t max_total_bytes;     /* input size and size of angles plus intensities */
     };
 
-    static bool load_ldt(const std::string& filename, std::string& err_out, std::string& warn_out, light& ldt_out) {
-        std::ifstream f(filename);
-        if (!f) {
-            err_out = "Failed reading file: " + filename;
+    // the loaders come in two flavours: err/warn strings, or a list of diagnostics with line numbers and byte offsets.
+    // diagnostics are appended, a load failed if it returns false and the last diagnostic is the error
+    static bool load_ldt(const std::string& filename, std::vector<diagnostic>& diagnostics_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        mapped_file f;
+        if (!f.open(filename)) {
+            diagnostics_out.push_back(read_failed());
             return false;
         }
+        parse_context ctx(diagnostics_out, limits, f.data());
+        return parse_ldt(f.data(), f.size(), ctx, ldt_out);
+    }
 
-        ldt_out = {};
-        std::string line;
+    static bool load_ldt(const std::string& filename, std::string& err_out, std::string& warn_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt(filename, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, filename, err_out, warn_out);
+        return ok;
+    }
+
+    // parses the ldt directly from the given buffer, the buffer is not copied and does not need to be null terminated
+    static bool load_ldt_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_ldt(data, size, ctx, ldt_out);
+    }
 
-#define NEXT_LINE(name) if (!std::getline(f, line)) { err_out = "Error reading <" name "> property: " + filename; f.close(); return false; }
-#define CATCH(a) try{a;} catch (...) { warn_out = "Some values could not be read"; }
+    static bool load_ldt_from_memory(const char* data, const size_t size, std::string& err_out, std::string& warn_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_from_memory(data, size, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, memory_source(), err_out, warn_out);
+        return ok;
+    }
 
-        /* line  1 */ NEXT_LINE("Manufacturer") ldt_out.manufacturer = line;
-        /* line  2 */ NEXT_LINE("Type") CATCH(convertToType(line, ldt_out.ltyp))
-        /* line  3 */ NEXT_LINE("Symmetry") CATCH(convertToType(line, ldt_out.lsym))
-        /* line  4 */ NEXT_LINE("Mc") CATCH(convertToType(line, ldt_out.mc))
-        if (calc_mc1_mc2(ldt_out)) {
-            err_out = "Error reading light symmetry";
+    // loads lines 1 - 27 only (everything up to and including the direct ratios), angles and intensities stay empty
+    // data_offset receives the byte offset of line 28 which lets load_ldt_data continue later without scanning the header again
+    static bool load_ldt_header(const std::string& filename, std::vector<diagnostic>& diagnostics_out, light& ldt_out, size_t* data_offset = nullptr, const load_limits& limits = load_limits()) {
+        mapped_file f;
+        if (!f.open(filename)) {
+            diagnostics_out.push_back(read_failed());
             return false;
         }
-        /* line  5 */ NEXT_LINE("Dc") CATCH(convertToType(line, ldt_out.dc))
-        /* line  6 */ NEXT_LINE("Ng") CATCH(convertToType(line, ldt_out.ng))
-        /* line  7 */ NEXT_LINE("Dg") CATCH(convertToType(line, ldt_out.dg))
-
-        /* line  8 */ NEXT_LINE("Measurement report number") ldt_out.measurement_report_number = line;
-        /* line  9 */ NEXT_LINE("Luminaire name") ldt_out.luminaire_name = line;
-        /* line 10 */ NEXT_LINE("Luminaire number") ldt_out.luminaire_number = line;
-        /* line 11 */ NEXT_LINE("File name") ldt_out.file_name = line;
-        /* line 12 */ NEXT_LINE("Date/user") ldt_out.date_user = line;
-
-        /* line 13 */ NEXT_LINE("Length/diameter of luminaire") CATCH(convertToType(line, ldt_out.length_luminaire))
-		/* line 14 */ NEXT_LINE("Width of luminaire") CATCH(convertToType(line, ldt_out.width_luminaire))
-		/* line 15 */ NEXT_LINE("Height of luminaire") CATCH(convertToType(line, ldt_out.height_luminaire))
-		/* line 16 */ NEXT_LINE("Length/diameter of luminous area") CATCH(convertToType(line, ldt_out.length_luminous_area))
-		/* line 17 */ NEXT_LINE("Width of luminous area") CATCH(convertToType(line, ldt_out.width_luminous_area))
-		/* line 18 */ NEXT_LINE("Height of luminous area C0-plane") CATCH(convertToType(line, ldt_out.height_luminous_area_c0))
-		/* line 19 */ NEXT_LINE("Height of luminous area C90-plane") CATCH(convertToType(line, ldt_out.height_luminous_area_c90))
-		/* line 20 */ NEXT_LINE("Height of luminous area C180-plane") CATCH(convertToType(line, ldt_out.height_luminous_area_c180))
-		/* line 21 */ NEXT_LINE("Height of luminous area C270-plane") CATCH(convertToType(line, ldt_out.height_luminous_area_c270))
-		/* line 22 */ NEXT_LINE("Downward flux fraction") CATCH(convertToType(line, ldt_out.dff))
-		/* line 23 */ NEXT_LINE("Light output ratio luminaire") CATCH(convertToType(line, ldt_out.lorl))
-		/* line 24 */ NEXT_LINE("Conversion factor for luminous intensities") CATCH(convertToType(line, ldt_out.conversion_factor))
-		/* line 25 */ NEXT_LINE("Tilt of luminaire during measurement") CATCH(convertToType(line, ldt_out.tilt_of_luminaire))
-		/* line 26 */ NEXT_LINE("Number of standard sets of lamps") CATCH(convertToType(line, ldt_out.n))
+        parse_context ctx(diagnostics_out, limits, f.data());
+        return parse_ldt_header(f.data(), f.size(), ctx, ldt_out, data_offset);
+    }
 
-        // for each in the file defined lamp
-        ldt_out.lamp_data.resize(ldt_out.n);
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26a */ NEXT_LINE("Number of lamps") CATCH(convertToType(line, ld.number_of_lamps))
+    static bool load_ldt_header(const std::string& filename, std::string& err_out, std::string& warn_out, light& ldt_out, size_t* data_offset = nullptr, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_header(filename, diagnostics, ldt_out, data_offset, limits);
+        to_err_warn(diagnostics, filename, err_out, warn_out);
+        return ok;
+    }
+
+    static bool load_ldt_header_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, light& ldt_out, size_t* data_offset = nullptr, const load_limits& limits = load_limits()) {
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_ldt_header(data, size, ctx, ldt_out, data_offset);
+    }
+
+    static bool load_ldt_header_from_memory(const char* data, const size_t size, std::string& err_out, std::string& warn_out, light& ldt_out, size_t* data_offset = nullptr, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_header_from_memory(data, size, diagnostics, ldt_out, data_offset, limits);
+        to_err_warn(diagnostics, memory_source(), err_out, warn_out);
+        return ok;
+    }
+
+    // loads lines 28 - 30 starting at data_offset into a light whose header was read by load_ldt_header
+    static bool load_ldt_data(const std::string& filename, const size_t data_offset, std::vector<diagnostic>& diagnostics_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        mapped_file f;
+        if (!f.open(filename)) {
+            diagnostics_out.push_back(read_failed());
+            return false;
+        }
+        parse_context ctx(diagnostics_out, limits, f.data());
+        return parse_ldt_data(f.data(), f.size(), data_offset, ctx, ldt_out);
+    }
+
+    static bool load_ldt_data(const std::string& filename, const size_t data_offset, std::string& err_out, std::string& warn_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_data(filename, data_offset, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, filename, err_out, warn_out);
+        return ok;
+    }
+
+    static bool load_ldt_data_from_memory(const char* data, const size_t size, const size_t data_offset, std::vector<diagnostic>& diagnostics_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_ldt_data(data, size, data_offset, ctx, ldt_out);
+    }
+
+    static bool load_ldt_data_from_memory(const char* data, const size_t size, const size_t data_offset, std::string& err_out, std::string& warn_out, light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_data_from_memory(data, size, data_offset, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, memory_source(), err_out, warn_out);
+        return ok;
+    }
+
+    // light whose angles and intensities (lines 28 - 30) are decoded on first access
+    // until then the mapped file, or the caller's buffer, is referenced and has to stay alive. not thread safe
+    class lazy_light {
+    public:
+        explicit lazy_light(const Alloc& alloc = Alloc()) : light_(alloc), data_(nullptr), size_(0), data_offset_(0), pending_(false), ok_(true) {}
+
+        // header fields are always available, angles and intensities are empty until decoded
+        const light& header() const { return light_; }
+        const light& get() const { ensure(); return light_; }
+        const vector_type<T>& angles_c() const { ensure(); return light_.angles_c; }
+        const vector_type<T>& angles_g() const { ensure(); return light_.angles_g; }
+        const vector_type<T>& luminous_intensity_distribution() const { ensure(); return light_.luminous_intensity_distribution; }
+
+        bool decoded() const { return !pending_; }
+        // decodes now, the accessors above do the same but discard the diagnostics. the source is released afterwards
+        bool decode(std::vector<diagnostic>& diagnostics_out) const {
+            if (!pending_) return ok_;
+            pending_ = false;
+            parse_context ctx(diagnostics_out, limits_, data_);
+            ok_ = parse_ldt_data(data_, size_, data_offset_, ctx, light_);
+            file_.reset();
+            data_ = nullptr;
+            size_ = 0;
+            return ok_;
+        }
+
+        bool decode(std::string& err_out, std::string& warn_out) const {
+            std::vector<diagnostic> diagnostics;
+            const bool ok = decode(diagnostics);
+            to_err_warn(diagnostics, source_, err_out, warn_out);
+            return ok;
+        }
+
+    private:
+        friend struct tiny_ldt;
+
+        void ensure() const {
+            if (!pending_) return;
+            std::vector<diagnostic> diagnostics;
+            decode(diagnostics);
+        }
+
+        mutable light light_;
+        mutable std::shared_ptr<mapped_file> file_;
+        mutable const char* data_;
+        mutable size_t size_;
+        size_t data_offset_;
+        std::string source_;
+        load_limits limits_;
+        mutable bool pending_;
+        mutable bool ok_;
+    };
+
+    // the diagnostics of the later decoding are only reported by lazy_light::decode
+    static bool load_ldt_lazy(const std::string& filename, std::vector<diagnostic>& diagnostics_out, lazy_light& ldt_out, const load_limits& limits = load_limits()) {
+        std::shared_ptr<mapped_file> f = std::make_shared<mapped_file>();
+        if (!f->open(filename)) {
+            diagnostics_out.push_back(read_failed());
+            return false;
+        }
+        parse_context ctx(diagnostics_out, limits, f->data());
+        if (!parse_lazy(f->data(), f->size(), ctx, filename, ldt_out)) return false;
+        ldt_out.file_ = f;
+        return true;
+    }
+
+    static bool load_ldt_lazy(const std::string& filename, std::string& err_out, std::string& warn_out, lazy_light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_lazy(filename, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, filename, err_out, warn_out);
+        return ok;
+    }
+
+    // the buffer is referenced, not copied, and has to outlive the decoding of the lazy_light
+    static bool load_ldt_lazy_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, lazy_light& ldt_out, const load_limits& limits = load_limits()) {
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_lazy(data, size, ctx, memory_source(), ldt_out);
+    }
+
+    static bool load_ldt_lazy_from_memory(const char* data, const size_t size, std::string& err_out, std::string& warn_out, lazy_light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_lazy_from_memory(data, size, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, memory_source(), err_out, warn_out);
+        return ok;
+    }
+
+    // non owning view of a contiguous range, e.g. the characters or values of an arena_light
+    template <typename V>
+    class view {
+    public:
+        view() : data_(nullptr), size_(0) {}
+        view(const V* data, const size_t size) : data_(data), size_(size) {}
+
+        const V* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        const V* begin() const { return data_; }
+        const V* end() const { return data_ + size_; }
+        const V& operator[](const size_t i) const { return data_[i]; }
+
+    private:
+        const V* data_;
+        size_t size_;
+    };
+
+    static std::string to_string(const view<char>& v) { return std::string(v.begin(), v.end()); }
+
+    // a light whose strings, lamp sets, angles and intensities share one allocation, the fields match light.
+    // the views stay valid as long as the arena_light (moving it keeps them valid, it cannot be copied)
+    class arena_light {
+    public:
+        struct lamp_data_s {
+            int number_of_lamps; // negative sign indicates absolute photometry
+            view<char> type_of_lamps;
+            uint32_t total_luminous_flux;   /* lm */
+            uint32_t color_temperature;
+            uint32_t color_rendering_group;
+            T watt;                         /* W */
+        };
+
+        explicit arena_light(const Alloc& alloc = Alloc()) : arena_(nullptr, block_deleter(alloc)), arena_size_(0) { assign_header(light(alloc)); }
+        arena_light(arena_light&&) = default;
+        arena_light& operator=(arena_light&&) = default;
+
+        view<char> manufacturer;
+        uint32_t ltyp;
+        uint32_t lsym;
+        uint32_t mc, mc1, mc2;
+        T dc;
+        uint32_t ng;
+        T dg;
+
+        view<char> measurement_report_number;
+        view<char> luminaire_name;
+        view<char> luminaire_number;
+        view<char> file_name;
+        view<char> date_user;
+
+        uint32_t height_luminaire;
+        uint32_t length_luminaire;
+        uint32_t width_luminaire;
+
+        uint32_t length_luminous_area;
+        uint32_t width_luminous_area;
+        uint32_t height_luminous_area_c0;
+        uint32_t height_luminous_area_c90;
+        uint32_t height_luminous_area_c180;
+        uint32_t height_luminous_area_c270;
+
+        T dff;
+        T lorl;
+        T conversion_factor;
+        uint32_t tilt_of_luminaire;
+        uint32_t n;
+
+        view<lamp_data_s> lamp_data;
+
+        std::array<T, 10> dr;
+        view<T> angles_c;
+        view<T> angles_g;
+        view<T> luminous_intensity_distribution; /* cd/1000 lumens */
+
+        // bytes of the single allocation
+        size_t arena_size() const { return arena_size_; }
+        allocator_type get_allocator() const { return allocator_type(arena_.get_deleter().alloc); }
+
+        // copy with owning strings and vectors, e.g. for write_ldt
+        light to_light(const Alloc& alloc = Alloc()) const {
+            light l(alloc);
+            l.manufacturer.assign(manufacturer.begin(), manufacturer.end());
+            l.ltyp = ltyp; l.lsym = lsym;
+            l.mc = mc; l.mc1 = mc1; l.mc2 = mc2;
+            l.dc = dc; l.ng = ng; l.dg = dg;
+            l.measurement_report_number.assign(measurement_report_number.begin(), measurement_report_number.end());
+            l.luminaire_name.assign(luminaire_name.begin(), luminaire_name.end());
+            l.luminaire_number.assign(luminaire_number.begin(), luminaire_number.end());
+            l.file_name.assign(file_name.begin(), file_name.end());
+            l.date_user.assign(date_user.begin(), date_user.end());
+            l.height_luminaire = height_luminaire; l.length_luminaire = length_luminaire; l.width_luminaire = width_luminaire;
+            l.length_luminous_area = length_luminous_area; l.width_luminous_area = width_luminous_area;
+            l.height_luminous_area_c0 = height_luminous_area_c0; l.height_luminous_area_c90 = height_luminous_area_c90;
+            l.height_luminous_area_c180 = height_luminous_area_c180; l.height_luminous_area_c270 = height_luminous_area_c270;
+            l.dff = dff; l.lorl = lorl;
+            l.conversion_factor = conversion_factor; l.tilt_of_luminaire = tilt_of_luminaire;
+            l.n = n;
+            resize_lamp_data(l, lamp_data.size());
+            for (size_t i = 0; i < lamp_data.size(); ++i) {
+                typename light::lamp_data_s& ld = l.lamp_data[i];
+                ld.number_of_lamps = lamp_data[i].number_of_lamps;
+                ld.type_of_lamps.assign(lamp_data[i].type_of_lamps.begin(), lamp_data[i].type_of_lamps.end());
+                ld.total_luminous_flux = lamp_data[i].total_luminous_flux;
+                ld.color_temperature = lamp_data[i].color_temperature;
+                ld.color_rendering_group = lamp_data[i].color_rendering_group;
+                ld.watt = lamp_data[i].watt;
+            }
+            l.dr = dr;
+            l.angles_c.assign(angles_c.begin(), angles_c.end());
+            l.angles_g.assign(angles_g.begin(), angles_g.end());
+            l.luminous_intensity_distribution.assign(luminous_intensity_distribution.begin(), luminous_intensity_distribution.end());
+            return l;
+        }
+
+    private:
+        friend struct tiny_ldt;
+
+        // copies the header of h and lays out the arena: lamp sets, then angles and intensities (zeroed), then characters
+        void assign_header(const light& h) {
+            const size_t values = static_cast<size_t>(h.mc) + h.ng + intensity_count(h);
+            size_t chars = h.manufacturer.size() + h.measurement_report_number.size() + h.luminaire_name.size() +
+                h.luminaire_number.size() + h.file_name.size() + h.date_user.size();
+            for (const auto& ld : h.lamp_data) chars += ld.type_of_lamps.size();
+            // sizeof(lamp_data_s) is a multiple of its alignment, which is at least that of T
+            const size_t values_offset = h.lamp_data.size() * sizeof(lamp_data_s);
+            const size_t chars_offset = values_offset + values * sizeof(T);
+            arena_size_ = chars_offset + chars;
+            const size_t units = (arena_size_ + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+            arena_.reset();
+            arena_.get_deleter().units = units;
+            arena_.reset(units ? std::allocator_traits<block_allocator>::allocate(arena_.get_deleter().alloc, units) : nullptr);
+            char* base = reinterpret_cast<char*>(arena_.get());
+
+            char* c = base + chars_offset;
+            manufacturer = copy(c, h.manufacturer);
+            measurement_report_number = copy(c, h.measurement_report_number);
+            luminaire_name = copy(c, h.luminaire_name);
+            luminaire_number = copy(c, h.luminaire_number);
+            file_name = copy(c, h.file_name);
+            date_user = copy(c, h.date_user);
+
+            lamp_data_s* lamps = reinterpret_cast<lamp_data_s*>(base);
+            for (size_t i = 0; i < h.lamp_data.size(); ++i) {
+                const typename light::lamp_data_s& ld = h.lamp_data[i];
+                lamp_data_s& out = *new (lamps + i) lamp_data_s();
+                out.number_of_lamps = ld.number_of_lamps;
+                out.type_of_lamps = copy(c, ld.type_of_lamps);
+                out.total_luminous_flux = ld.total_luminous_flux;
+                out.color_temperature = ld.color_temperature;
+                out.color_rendering_group = ld.color_rendering_group;
+                out.watt = ld.watt;
+            }
+            lamp_data = view<lamp_data_s>(lamps, h.lamp_data.size());
+
+            T* v = values_ = reinterpret_cast<T*>(base + values_offset);
+            std::fill(v, v + values, T(0));
+            angles_c = view<T>(v, h.mc);
+            angles_g = view<T>(v + h.mc, h.ng);
+            luminous_intensity_distribution = view<T>(v + h.mc + h.ng, intensity_count(h));
+
+            ltyp = h.ltyp; lsym = h.lsym;
+            mc = h.mc; mc1 = h.mc1; mc2 = h.mc2;
+            dc = h.dc; ng = h.ng; dg = h.dg;
+            height_luminaire = h.height_luminaire; length_luminaire = h.length_luminaire; width_luminaire = h.width_luminaire;
+            length_luminous_area = h.length_luminous_area; width_luminous_area = h.width_luminous_area;
+            height_luminous_area_c0 = h.height_luminous_area_c0; height_luminous_area_c90 = h.height_luminous_area_c90;
+            height_luminous_area_c180 = h.height_luminous_area_c180; height_luminous_area_c270 = h.height_luminous_area_c270;
+            dff = h.dff; lorl = h.lorl;
+            conversion_factor = h.conversion_factor; tilt_of_luminaire = h.tilt_of_luminaire;
+            n = h.n;
+            dr = h.dr;
+        }
+
+        static view<char> copy(char*& out, const string_type& s) {
+            const view<char> v(out, s.size());
+            if (!s.empty()) std::memcpy(out, s.data(), s.size());
+            out += s.size();
+            return v;
+        }
+
+        // writable start of the angles and intensities (lines 28 - 30), in this order
+        T* values_;
+        // the arena comes from Alloc, in units aligned for every member
+        typedef typename std::allocator_traits<Alloc>::template rebind_alloc<std::max_align_t> block_allocator;
+        struct block_deleter {
+            explicit block_deleter(const Alloc& a) : alloc(a), units(0) {}
+            void operator()(std::max_align_t* p) { std::allocator_traits<block_allocator>::deallocate(alloc, p, units); }
+            block_allocator alloc;
+            size_t units;
+        };
+        std::unique_ptr<std::max_align_t, block_deleter> arena_;
+        size_t arena_size_;
+    };
+
+    // loads into a single allocation. the header is read into a temporary light first, use loader to reuse it
+    static bool load_ldt(const std::string& filename, std::vector<diagnostic>& diagnostics_out, arena_light& ldt_out, const load_limits& limits = load_limits()) {
+        light scratch(ldt_out.get_allocator());
+        mapped_file f;
+        if (!f.open(filename)) {
+            diagnostics_out.push_back(read_failed());
+            return false;
+        }
+        parse_context ctx(diagnostics_out, limits, f.data());
+        return parse_arena(f.data(), f.size(), ctx, scratch, ldt_out);
+    }
+
+    static bool load_ldt(const std::string& filename, std::string& err_out, std::string& warn_out, arena_light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt(filename, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, filename, err_out, warn_out);
+        return ok;
+    }
+
+    static bool load_ldt_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, arena_light& ldt_out, const load_limits& limits = load_limits()) {
+        light scratch(ldt_out.get_allocator());
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_arena(data, size, ctx, scratch, ldt_out);
+    }
+
+    static bool load_ldt_from_memory(const char* data, const size_t size, std::string& err_out, std::string& warn_out, arena_light& ldt_out, const load_limits& limits = load_limits()) {
+        std::vector<diagnostic> diagnostics;
+        const bool ok = load_ldt_from_memory(data, size, diagnostics, ldt_out, limits);
+        to_err_warn(diagnostics, memory_source(), err_out, warn_out);
+        return ok;
+    }
+
+    // many lights with the scalar header fields in columns (one entry per light) and the angles and intensities
+    // of all lights in one buffer, so a scan over a field reads contiguous memory. the columns are read only,
+    // lights are appended with add or load_ldt
+    class light_pool {
+    public:
+        explicit light_pool(const Alloc& alloc = Alloc()) :
+            ltyp(alloc), lsym(alloc), mc(alloc), mc1(alloc), mc2(alloc), dc(alloc), ng(alloc), dg(alloc),
+            length_luminaire(alloc), width_luminaire(alloc), height_luminaire(alloc),
+            length_luminous_area(alloc), width_luminous_area(alloc),
+            dff(alloc), lorl(alloc), conversion_factor(alloc),
+            total_luminous_flux(alloc), watt(alloc), color_temperature(alloc),
+            value_offset(1, 0, alloc), values(alloc)
+        {}
+
+        size_t size() const { return ltyp.size(); }
+        bool empty() const { return ltyp.empty(); }
+
+        // angles and intensities of light i
+        view<T> angles_c(const size_t i) const { return view<T>(values.data() + value_offset[i], mc[i]); }
+        view<T> angles_g(const size_t i) const { return view<T>(values.data() + value_offset[i] + mc[i], ng[i]); }
+        view<T> luminous_intensity_distribution(const size_t i) const {
+            const size_t begin = value_offset[i] + mc[i] + ng[i];
+            return view<T>(values.data() + begin, value_offset[i + 1] - begin);
         }
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26b */ NEXT_LINE("Type of lamps") ld.type_of_lamps = line;
+
+        // appends a copy of l, returns its index
+        size_t add(const light& l) {
+            T* out = append_header(l);
+            out = std::copy(l.angles_c.begin(), l.angles_c.end(), out);
+            out = std::copy(l.angles_g.begin(), l.angles_g.end(), out);
+            std::copy(l.luminous_intensity_distribution.begin(), l.luminous_intensity_distribution.end(), out);
+            return size() - 1;
         }
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26c */ NEXT_LINE("Total luminous flux") CATCH(convertToType(line, ld.total_luminous_flux))
+
+        void reserve(const size_t lights, const size_t total_values) {
+            each_column(column_reserve(lights));
+            value_offset.reserve(lights + 1);
+            values.reserve(total_values);
         }
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26d */ NEXT_LINE("Color appearance") CATCH(convertToType(line, ld.color_temperature))
+
+        void clear() { truncate(0); }
+
+        vector_type<uint32_t> ltyp;
+        vector_type<uint32_t> lsym;
+        vector_type<uint32_t> mc, mc1, mc2;
+        vector_type<T> dc;
+        vector_type<uint32_t> ng;
+        vector_type<T> dg;
+
+        vector_type<uint32_t> length_luminaire;        /* mm */
+        vector_type<uint32_t> width_luminaire;         /* mm */
+        vector_type<uint32_t> height_luminaire;        /* mm */
+        vector_type<uint32_t> length_luminous_area;    /* mm */
+        vector_type<uint32_t> width_luminous_area;     /* mm */
+
+        vector_type<T> dff;                            /* % */
+        vector_type<T> lorl;                           /* % */
+        vector_type<T> conversion_factor;
+
+        vector_type<T> total_luminous_flux;            /* lm, sum over all lamp sets */
+        vector_type<T> watt;                           /* W, sum over all lamp sets */
+        vector_type<uint32_t> color_temperature;       /* of the first lamp set, 0 without lamps */
+
+        vector_type<size_t> value_offset;              /* size() + 1 entries, light i owns values[value_offset[i], value_offset[i + 1]) */
+        vector_type<T> values;                         /* per light: angles c, angles g, intensities */
+
+    private:
+        friend struct tiny_ldt;
+
+        struct column_reserve {
+            explicit column_reserve(const size_t count) : n(count) {}
+            template <typename V> void operator()(V& v) const { v.reserve(n); }
+            size_t n;
+        };
+
+        struct column_truncate {
+            explicit column_truncate(const size_t count) : n(count) {}
+            template <typename V> void operator()(V& v) const { v.resize(n); }
+            size_t n;
+        };
+
+        template <typename F>
+        void each_column(const F& f) {
+            f(ltyp); f(lsym); f(mc); f(mc1); f(mc2); f(dc); f(ng); f(dg);
+            f(length_luminaire); f(width_luminaire); f(height_luminaire);
+            f(length_luminous_area); f(width_luminous_area);
+            f(dff); f(lorl); f(conversion_factor);
+            f(total_luminous_flux); f(watt); f(color_temperature);
         }
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26e */ NEXT_LINE("Color rendering group") CATCH(convertToType(line, ld.color_rendering_group))
+
+        // appends the header fields of h and room for its values (zeroed), returns where they go
+        T* append_header(const light& h) {
+            ltyp.push_back(h.ltyp); lsym.push_back(h.lsym);
+            mc.push_back(h.mc); mc1.push_back(h.mc1); mc2.push_back(h.mc2);
+            dc.push_back(h.dc); ng.push_back(h.ng); dg.push_back(h.dg);
+            length_luminaire.push_back(h.length_luminaire); width_luminaire.push_back(h.width_luminaire); height_luminaire.push_back(h.height_luminaire);
+            length_luminous_area.push_back(h.length_luminous_area); width_luminous_area.push_back(h.width_luminous_area);
+            dff.push_back(h.dff); lorl.push_back(h.lorl); conversion_factor.push_back(h.conversion_factor);
+            T flux = 0;
+            T w = 0;
+            for (const auto& ld : h.lamp_data) {
+                flux += static_cast<T>(ld.total_luminous_flux);
+                w += ld.watt;
+            }
+            total_luminous_flux.push_back(flux);
+            watt.push_back(w);
+            color_temperature.push_back(h.lamp_data.empty() ? 0 : h.lamp_data[0].color_temperature);
+            const size_t begin = values.size();
+            values.resize(begin + h.mc + h.ng + intensity_count(h));
+            value_offset.push_back(values.size());
+            return values.data() + begin;
         }
-        for (auto& ld : ldt_out.lamp_data) {
-            /* line 26f */ NEXT_LINE("Wattage including ballast") CATCH(convertToType(line, ld.watt))
+
+        // drops every light from index n on
+        void truncate(const size_t n) {
+            each_column(column_truncate(n));
+            value_offset.resize(n + 1);
+            values.resize(value_offset[n]);
         }
-        for (T& v : ldt_out.dr) {
-            /* line 27 */ NEXT_LINE("Direct ratios for room indices k = 0.6 ... 5") CATCH(convertToType(line, v))
+    };
+
+    // the intensities of one light as 16 bit half floats relative to the largest magnitude, 2 bytes per value
+    // instead of sizeof(T). dequantized values are within a relative error of 2^-11 (0.049 %) of the original for
+    // every value above peak * 2^-14, smaller values are within an absolute error of peak * 2^-25
+    class quantized_intensities {
+    public:
+        explicit quantized_intensities(const Alloc& alloc = Alloc()) : scale_(1), bits_(alloc) {}
+        explicit quantized_intensities(const light& l) : scale_(1), bits_(l.get_allocator()) {
+            assign(view<T>(l.luminous_intensity_distribution.data(), l.luminous_intensity_distribution.size()));
         }
-        ldt_out.angles_c.resize(ldt_out.mc);
-        for (T& v : ldt_out.angles_c) {
-            /* line 28 */ NEXT_LINE("Angles C") CATCH(convertToType(line, v))
+        explicit quantized_intensities(const view<T>& values, const Alloc& alloc = Alloc()) : scale_(1), bits_(alloc) { assign(values); }
+
+        void assign(const view<T>& values) {
+            T peak = 0;
+            for (const T v : values) {
+                if (std::abs(v) > peak) peak = std::abs(v);
+            }
+            scale_ = peak > 0 && std::isfinite(peak) ? peak : T(1);
+            bits_.resize(values.size());
+            for (size_t i = 0; i < values.size(); ++i) bits_[i] = to_half(static_cast<float>(values[i] / scale_));
         }
-        ldt_out.angles_g.resize(ldt_out.ng);
-        for (T& v : ldt_out.angles_g) {
-            /* line 29 */ NEXT_LINE("Angles G") CATCH(convertToType(line, v))
+
+        size_t size() const { return bits_.size(); }
+        bool empty() const { return bits_.empty(); }
+        T operator[](const size_t i) const { return static_cast<T>(from_half(bits_[i])) * scale_; }
+
+        // dequantizes all values into out[0, size())
+        void decode(T* out) const {
+            for (size_t i = 0; i < bits_.size(); ++i) out[i] = static_cast<T>(from_half(bits_[i])) * scale_;
         }
-        // 30 ((Mc2 - Mc1 + 1) * Ng)
-        // if lsym 0 : mc1 = 1, mc2 = mc
-        // if lsym 1 : mc1 = 1, mc2 = 1
-        // if lsym 2 : mc1 = 1, mc2 = mc / 2 + 1
-        // if lsym 3 : mc1 = 3 * mc / 4 + 1, mc2 = mc1 + mc / 2
-        // if lsym 4 : mc1 = 1, mc2 = mc / 4 + 1
-        ldt_out.luminous_intensity_distribution.resize((static_cast<size_t>(ldt_out.mc2) - static_cast<size_t>(ldt_out.mc1) + 1) * static_cast<size_t>(ldt_out.ng));
-        for (T& v : ldt_out.luminous_intensity_distribution) {
-            /* line 29 */ NEXT_LINE("Luminous intensity distribution") CATCH(convertToType(line, v))
+
+        T scale() const { return scale_; }
+        const vector_type<uint16_t>& bits() const { return bits_; }
+
+        // bound for values above scale() * 2^-14
+        static T max_relative_error() { return T(1) / 2048; }
+
+    private:
+        T scale_;
+        vector_type<uint16_t> bits_;
+    };
+
+    // appends the light to the pool, angles and intensities are decoded straight into its shared buffer.
+    // nothing is appended if loading fails
+    static bool load_ldt(const std::string& filename, std::vector<diagnostic>& diagnostics_out, light_pool& pool, const load_limits& limits = load_limits()) {
+        light scratch(pool.values.get_allocator());
+        mapped_file f;
+        if (!f.open(filename)) {
+            diagnostics_out.push_back(read_failed());
+            return false;
         }
+        parse_context ctx(diagnostics_out, limits, f.data());
+        return parse_pool(f.data(), f.size(), ctx, scratch, pool);
+    }
 
-#undef NEXT_LINE
-#undef CATCH
-        f.close();
-        return true;
+    static bool load_ldt_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, light_pool& pool, const load_limits& limits = load_limits()) {
+        light scratch(pool.values.get_allocator());
+        parse_context ctx(diagnostics_out, limits, data);
+        return parse_pool(data, size, ctx, scratch, pool);
     }
 
-    static bool write_ldt(const std::string& filename, const light& ldt, const uint32_t precision = std::numeric_limits<T>::max_digits10) {
-        std::stringstream ss;
-        ss.precision(precision);
-
-        /* line  1 */ ss << ldt.manufacturer << std::endl;
-        /* line  2 */ ss << ldt.ltyp << std::endl;
-        /* line  3 */ ss << ldt.lsym << std::endl;
-        /* line  4 */ ss << ldt.mc << std::endl;
-        /* line  5 */ ss << ldt.dc << std::endl;
-        /* line  6 */ ss << ldt.ng << std::endl;
-        /* line  7 */ ss << ldt.dg << std::endl;
-
-        /* line  8 */ ss << ldt.measurement_report_number << std::endl;
-        /* line  9 */ ss << ldt.luminaire_name << std::endl;
-        /* line 10 */ ss << ldt.luminaire_number << std::endl;
-        /* line 11 */ ss << ldt.file_name << std::endl;
-        /* line 12 */ ss << ldt.date_user << std::endl;
-
-        /* line 13 */ ss << ldt.length_luminaire << std::endl;
-        /* line 14 */ ss << ldt.width_luminaire << std::endl;
-        /* line 15 */ ss << ldt.height_luminaire << std::endl;
-        /* line 16 */ ss << ldt.length_luminous_area << std::endl;
-        /* line 17 */ ss << ldt.width_luminous_area << std::endl;
-        /* line 18 */ ss << ldt.height_luminous_area_c0 << std::endl;
-        /* line 19 */ ss << ldt.height_luminous_area_c90 << std::endl;
-        /* line 20 */ ss << ldt.height_luminous_area_c180 << std::endl;
-        /* line 21 */ ss << ldt.height_luminous_area_c270 << std::endl;
-        /* line 22 */ ss << ldt.dff << std::endl;
-        /* line 23 */ ss << ldt.lorl << std::endl;
-        /* line 24 */ ss << ldt.conversion_factor << std::endl;
-        /* line 25 */ ss << ldt.tilt_of_luminaire << std::endl;
-        /* line 26 */ ss << ldt.n << std::endl;
+    // reusable loading context for many files on one thread. keeps the read buffer of the non mapped
+    // path alive between loads, together with clear() no allocations are needed once capacities settled
+    class loader {
+    public:
+        explicit loader(const load_limits& limits = load_limits(), const Alloc& alloc = Alloc()) : limits_(limits), scratch_(alloc) {}
 
-        // for each in the file defined lamp
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26a */ ss << ld.number_of_lamps << std::endl;
+        bool load(const std::string& filename, std::vector<diagnostic>& diagnostics_out, light& ldt_out) {
+            if (!file_.open(filename)) {
+                diagnostics_out.push_back(read_failed());
+                return false;
+            }
+            parse_context ctx(diagnostics_out, limits_, file_.data());
+            const bool ok = parse_ldt(file_.data(), file_.size(), ctx, ldt_out);
+            file_.close();
+            return ok;
         }
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26b */ ss << ld.type_of_lamps << std::endl;
+
+        bool load(const std::string& filename, std::string& err_out, std::string& warn_out, light& ldt_out) {
+            diagnostics_.clear();
+            const bool ok = load(filename, diagnostics_, ldt_out);
+            to_err_warn(diagnostics_, filename, err_out, warn_out);
+            return ok;
         }
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26c */ ss << ld.total_luminous_flux << std::endl;
+
+        bool load_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, light& ldt_out) {
+            parse_context ctx(diagnostics_out, limits_, data);
+            return parse_ldt(data, size, ctx, ldt_out);
         }
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26d */ ss << ld.color_temperature << std::endl;
+
+        bool load_from_memory(const char* data, const size_t size, std::string& err_out, std::string& warn_out, light& ldt_out) {
+            diagnostics_.clear();
+            const bool ok = load_from_memory(data, size, diagnostics_, ldt_out);
+            to_err_warn(diagnostics_, memory_source(), err_out, warn_out);
+            return ok;
         }
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26e */ ss << ld.color_rendering_group << std::endl;
+
+        // the header strings of arena loads go through a light kept by the loader
+        bool load(const std::string& filename, std::vector<diagnostic>& diagnostics_out, arena_light& ldt_out) {
+            if (!file_.open(filename)) {
+                diagnostics_out.push_back(read_failed());
+                return false;
+            }
+            parse_context ctx(diagnostics_out, limits_, file_.data());
+            const bool ok = parse_arena(file_.data(), file_.size(), ctx, scratch_, ldt_out);
+            file_.close();
+            return ok;
         }
-        for (const auto& ld : ldt.lamp_data) {
-            /* line 26f */ ss << ld.watt << std::endl;
+
+        bool load_from_memory(const char* data, const size_t size, std::vector<diagnostic>& diagnostics_out, arena_light& ldt_out) {
+            parse_context ctx(diagnostics_out, limits_, data);
+            return parse_arena(data, size, ctx, scratch_, ldt_out);
         }
-        for (const T& v : ldt.dr) {
-            /* line 27 */ ss << v << std::endl;
+
+        bool load(const std::string& filename, std::vector<diagnostic>& diagnostics_out, light_pool& pool) {
+            if (!file_.open(filename)) {
+                diagnostics_out.push_back(read_failed());
+                return false;
+            }
+            parse_context ctx(diagnostics_out, limits_, file_.data());
+            const bool ok = parse_pool(file_.data(), file_.size(), ctx, scratch_, pool);
+            file_.close();
+            return ok;
         }
-        for (const T& v : ldt.angles_c) {
-            /* line 28 */ ss << v << std::endl;
+
+    private:
+        mapped_file file_;
+        load_limits limits_;
+        std::vector<diagnostic> diagnostics_;
+        light scratch_;
+    };
+
+    struct batch_result {
+        explicit batch_result(const Alloc& alloc = Alloc()) : ldt(alloc), ok(false) {}
+
+        light ldt;
+        std::vector<diagnostic> diagnostics;
+        bool ok;
+    };
+
+    // loads all paths on a work stealing pool of threads (0 = hardware concurrency), results are in input order.
+    // every worker owns a contiguous range of the input and steals half of another range once its own is done.
+    // alloc is used for every result and for the scratch data of the workers
+    static std::vector<batch_result> load_ldt_batch(const std::vector<std::string>& paths, unsigned threads = 0, const load_limits& limits = load_limits(), const Alloc& alloc = Alloc()) {
+        std::vector<batch_result> results(paths.size(), batch_result(alloc));
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+        if (threads <= 1) {
+            loader l(limits, alloc);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                batch_result& r = results[i];
+                r.ok = l.load(paths[i], r.diagnostics, r.ldt);
+            }
+            return results;
         }
-        for (const T& v : ldt.angles_g) {
-            /* line 29 */ ss << v << std::endl;
+
+        std::vector<work_range> ranges(threads);
+        for (unsigned w = 0; w < threads; ++w) {
+            ranges[w].begin = paths.size() * w / threads;
+            ranges[w].end = paths.size() * (w + 1) / threads;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (unsigned w = 1; w < threads; ++w) workers.emplace_back(batch_worker, std::cref(paths), std::ref(results), std::ref(ranges), w, std::cref(limits), std::cref(alloc));
+        batch_worker(paths, results, ranges, 0, limits, alloc);
+        for (std::thread& t : workers) t.join();
+        return results;
+    }
+
+    // push parser for input that arrives in chunks. every complete line is parsed as soon as it is fed,
+    // only an incomplete last line is kept until the next chunk
+    class stream_parser {
+    public:
+        explicit stream_parser(const load_limits& limits = load_limits(), const Alloc& alloc = Alloc()) : source_("stream"), limits_(limits), light_(alloc), fed_(0), carry_offset_(0), failed_(false) {}
+
+        // returns false once the input cannot be parsed any further, finish reports the reason
+        bool feed(const char* data, const size_t size) {
+            if (failed_) return false;
+            const char* p = data;
+            const char* end = data + size;
+            if (!carry_.empty()) {
+                // complete the line that was split by the previous chunk boundary
+                const char* nl = static_cast<const char*>(std::memchr(p, '\n', size));
+                if (!nl) {
+                    carry_.append(p, end);
+                    fed_ += size;
+                    return true;
+                }
+                carry_.append(p, nl);
+                p = nl + 1;
+                if (!line(carry_.data(), carry_.data() + carry_.size(), carry_.data(), carry_offset_)) return false;
+                carry_.clear();
+            }
+            parse_context ctx(diagnostics_, limits_, data);
+            ctx.base_offset = fed_;
+            while (p != end && cursor_.f != field_end) {
+                if (vector_type<T>* values = field_values(cursor_.f, light_)) {
+                    if (cursor_.index == 0 && !prepare_values(cursor_.f, p, ctx, light_)) {
+                        failed_ = true;
+                        return false;
+                    }
+                    if (parse_value_batch(p, end, cursor_, values->data(), values->size(), ctx, light_) == 0) break;
+                    if (cursor_.index == values->size()) next_field(cursor_, light_);
+                    continue;
+                }
+                const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                if (!nl) break;
+                if (!line(p, nl, data, fed_)) return false;
+                p = nl + 1;
+            }
+            // anything after the last field is ignored, like trailing lines of a file
+            if (cursor_.f != field_end) {
+                if (carry_.empty()) carry_offset_ = fed_ + static_cast<size_t>(p - data);
+                carry_.append(p, end);
+            }
+            fed_ += size;
+            return true;
+        }
+
+        // parses the remaining line, moves the light to ldt_out and resets the parser for the next input
+        bool finish(std::vector<diagnostic>& diagnostics_out, light& ldt_out) {
+            if (!failed_ && !carry_.empty()) line(carry_.data(), carry_.data() + carry_.size(), carry_.data(), carry_offset_);
+            if (!failed_ && cursor_.f != field_end) {
+                parse_context ctx(diagnostics_, limits_, nullptr);
+                ctx.base_offset = fed_;
+                report(ctx, diagnostic_missing_line, cursor_.f, cursor_.index, nullptr, light_);
+                failed_ = true;
+            }
+            diagnostics_out.insert(diagnostics_out.end(), diagnostics_.begin(), diagnostics_.end());
+            const bool ok = !failed_;
+            if (ok) ldt_out = std::move(light_);
+            reset();
+            return ok;
+        }
+
+        bool finish(std::string& err_out, std::string& warn_out, light& ldt_out) {
+            std::vector<diagnostic> diagnostics;
+            const bool ok = finish(diagnostics, ldt_out);
+            to_err_warn(diagnostics, source_, err_out, warn_out);
+            return ok;
+        }
+
+        void reset() {
+            light_ = light(light_.get_allocator());
+            cursor_ = field_cursor();
+            carry_.clear();
+            diagnostics_.clear();
+            fed_ = 0;
+            carry_offset_ = 0;
+            failed_ = false;
         }
-        for (const T& v : ldt.luminous_intensity_distribution) {
-            /* line 30 */ ss << v << std::endl;
+
+        // position in the line sequence, e.g. to show progress
+        const field_cursor& cursor() const { return cursor_; }
+
+    private:
+        // base and base_offset map pointers into the line back to offsets in the whole stream
+        bool line(const char* b, const char* e, const char* base, const size_t base_offset) {
+            if (e != b && e[-1] == '\r') --e;
+            parse_context ctx(diagnostics_, limits_, base);
+            ctx.base_offset = base_offset;
+            failed_ = !parse_field(cursor_, b, e, ctx, light_);
+            return !failed_;
+        }
+
+        const std::string source_;
+        const load_limits limits_;
+        light light_;
+        field_cursor cursor_;
+        std::string carry_;
+        std::vector<diagnostic> diagnostics_;
+        size_t fed_;            /* bytes fed before the current chunk */
+        size_t carry_offset_;   /* stream offset of the first byte in carry_ */
+        bool failed_;
+    };
+
+    // full 360 degree grid of mc * ng intensities (plane after plane, as for lsym 0) from the stored planes mc1 - mc2.
+    // mirrored planes are copied as whole blocks of ng values. returns false if the intensities do not match the
+    // header or mc cannot be split by the symmetry (even for lsym 2, a multiple of 4 for lsym 3 and 4)
+    static bool expand_symmetry(const light& l, vector_type<T>& out) {
+        const size_t mc = l.mc;
+        const size_t ng = l.ng;
+        const size_t h = mc / 2;
+        const size_t q = mc / 4;
+        if (!symmetry_valid(l)) return false;
+        out.resize(mc * ng);
+        const T* in = l.luminous_intensity_distribution.data();
+        T* full = out.data();
+        switch (l.lsym) {
+        case 0:
+            copy_planes(in, 0, full, 0, mc, ng);
+            break;
+        case 1:
+            for (size_t c = 0; c < mc; ++c) copy_planes(in, 0, full, c, 1, ng);
+            break;
+        case 2:
+            // C0 - C180 stored, C180 - C360 mirrored at C0
+            copy_planes(in, 0, full, 0, h + 1, ng);
+            for (size_t c = h + 1; c < mc; ++c) copy_planes(in, mc - c, full, c, 1, ng);
+            break;
+        case 3:
+            // C270 - C360 - C90 stored, C90 - C270 mirrored at C90 (C -> 180 - C)
+            copy_planes(in, 0, full, 3 * q, q, ng);
+            copy_planes(in, q, full, 0, q + 1, ng);
+            for (size_t c = q + 1; c <= h; ++c) copy_planes(in, h + q - c, full, c, 1, ng);
+            for (size_t c = h + 1; c < 3 * q; ++c) copy_planes(in, 3 * q - c, full, c, 1, ng);
+            break;
+        case 4:
+            // C0 - C90 stored, the other quadrants mirrored
+            copy_planes(in, 0, full, 0, q + 1, ng);
+            for (size_t c = q + 1; c <= h; ++c) copy_planes(in, h - c, full, c, 1, ng);
+            for (size_t c = h + 1; c <= 3 * q; ++c) copy_planes(in, c - h, full, c, 1, ng);
+            for (size_t c = 3 * q + 1; c < mc; ++c) copy_planes(in, mc - c, full, c, 1, ng);
+            break;
         }
+        return true;
+    }
 
-        std::ofstream file(filename, std::ios::out | std::ios::trunc);
-        if (!file.is_open()) return false;
-        file << ss.rdbuf();
-        file.close();
+    // expands in place, afterwards lsym is 0 and mc1 - mc2 cover all planes
+    static bool expand_symmetry(light& l) {
+        vector_type<T> full(l.get_allocator());
+        if (!expand_symmetry(static_cast<const light&>(l), full)) return false;
+        l.luminous_intensity_distribution.swap(full);
+        l.lsym = 0;
+        calc_mc1_mc2(l);
         return true;
     }
 
-private:
-    template <typename U>
-    static void convertToType(const std::string& s, U& out)
-    {
-        if (std::is_same<T, float>::value) out = std::stof(s);
-        if (std::is_same<T, double>::value) out = std::stod(s);
-        if (std::is_same<T, int>::value) out = std::stoi(s);
-        if (std::is_same<T, uint32_t>::value) out = std::stoul(s);
+    // reads any of the mc planes of a light without expanding it, the stored plane is resolved on every access.
+    // the symmetry is a template parameter, so the mapping is a fold or two (min, no branches) in inner loops.
+    // Lsym has to match l.lsym, visit_intensity_view picks it at runtime. the light has to outlive the view
+    template <uint32_t Lsym>
+    class intensity_view {
+        static_assert(Lsym <= 4, "Lsym must be 0 - 4");
+
+    public:
+        explicit intensity_view(const light& l) : data_(l.luminous_intensity_distribution.data()), mc_(l.mc), ng_(l.ng) {}
+        // stored planes mc1 - mc2 of ng values each, e.g. from an arena_light or light_pool
+        intensity_view(const T* stored, const size_t mc, const size_t ng) : data_(stored), mc_(mc), ng_(ng) {}
+
+        // intensity of full plane c (0 <= c < mc) at gamma index g (0 <= g < ng)
+        T at(const size_t c, const size_t g) const { return data_[stored_plane(c) * ng_ + g]; }
+        // the ng intensities of full plane c
+        const T* plane(const size_t c) const { return data_ + stored_plane(c) * ng_; }
+
+        // index of full plane c within mc1 - mc2
+        size_t stored_plane(const size_t c) const {
+            switch (Lsym) {
+            case 1: return 0;
+            case 2: return std::min(c, mc_ - c);
+            case 3: {
+                // rotate C270 to 0, then C -> 180 - C becomes r -> mc - r
+                size_t r = c + mc_ / 4;
+                r -= r >= mc_ ? mc_ : 0;
+                return std::min(r, mc_ - r);
+            }
+            case 4: {
+                const size_t r = std::min(c, mc_ - c);
+                return std::min(r, mc_ / 2 - r);
+            }
+            default: return c;
+            }
+        }
+
+        size_t mc() const { return mc_; }
+        size_t ng() const { return ng_; }
+
+    private:
+        const T* data_;
+        size_t mc_;
+        size_t ng_;
+    };
+
+    // calls f(intensity_view<l.lsym>(l)), f needs a call operator for every intensity_view (or is a generic lambda).
+    // returns false without calling f if the intensities do not match the header, like expand_symmetry
+    template <typename F>
+    static bool visit_intensity_view(const light& l, F&& f) {
+        if (!symmetry_valid(l)) return false;
+        switch (l.lsym) {
+        case 0: f(intensity_view<0>(l)); break;
+        case 1: f(intensity_view<1>(l)); break;
+        case 2: f(intensity_view<2>(l)); break;
+        case 3: f(intensity_view<3>(l)); break;
+        case 4: f(intensity_view<4>(l)); break;
+        }
+        return true;
+    }
+
+    // tightest symmetry that holds for the distribution: 1, then 4, then 2 or 3, otherwise 0. every plane has to
+    // match the plane it would be mirrored from within tolerance * peak intensity, and the mirrored C angles have
+    // to match as well. returns l.lsym if the intensities do not match the header
+    static uint32_t detect_symmetry(const light& l, const T tolerance = 0) {
+        vector_type<T> full(l.get_allocator());
+        if (l.mc == 0 || !expand_symmetry(l, full)) return l.lsym;
+        T peak = 0;
+        for (const T v : full) peak = std::max(peak, std::abs(v));
+        static const uint32_t order[] = { 1, 4, 2, 3 };
+        for (const uint32_t lsym : order) {
+            if (symmetry_holds(l, full, lsym, tolerance * peak)) return lsym;
+        }
+        return 0;
+    }
+
+    // stores the distribution with the symmetry found by detect_symmetry, rewrites lsym, mc1, mc2 and the
+    // intensities. returns the new lsym
+    static uint32_t compress_symmetry(light& l, const T tolerance = 0) {
+        const uint32_t lsym = detect_symmetry(l, tolerance);
+        if (lsym == l.lsym) return lsym;
+        vector_type<T> full(l.get_allocator());
+        expand_symmetry(l, full);
+        l.lsym = lsym;
+        calc_mc1_mc2(l);
+        const size_t planes = l.mc2 - l.mc1 + 1;
+        l.luminous_intensity_distribution.resize(planes * l.ng);
+        for (size_t s = 0; s < planes; ++s) copy_planes(full.data(), (l.mc1 - 1 + s) % l.mc, l.luminous_intensity_distribution.data(), s, 1, l.ng);
+        return lsym;
+    }
+
+    // bilinear interpolation of the intensities (cd/1000 lumens, as stored) in any direction. the distribution is
+    // expanded to all mc planes on construction, so every symmetry is handled, and C wraps around at 360 degrees.
+    // cells are found in O(1) on equidistant angles (dc, dg matching the angles) and by binary search otherwise
+    class evaluator {
+    public:
+        explicit evaluator(const light& l) :
+            grid_(l.get_allocator()), angles_c_(l.get_allocator()), angles_g_(l.get_allocator()),
+            ng_(0), c_equidistant_(false), g_equidistant_(false), simd_(false), inv_dc_(0), inv_dg_(0)
+        {
+            if (l.mc == 0 || l.ng == 0 || l.angles_c.size() != l.mc || l.angles_g.size() != l.ng) return;
+            vector_type<T> full(l.get_allocator());
+            if (!expand_symmetry(l, full)) return;
+            const size_t mc = l.mc;
+            // a single gamma angle is widened to two equal columns so every lookup has a cell
+            ng_ = l.ng == 1 ? 2 : l.ng;
+            angles_g_.assign(l.angles_g.begin(), l.angles_g.end());
+            if (l.ng == 1) angles_g_.push_back(angles_g_[0] + 1);
+            // plane mc repeats plane 0 at C + 360 to close the circle
+            angles_c_.assign(l.angles_c.begin(), l.angles_c.end());
+            angles_c_.push_back(angles_c_[0] + 360);
+            grid_.resize((mc + 1) * ng_);
+            for (size_t c = 0; c <= mc; ++c) {
+                const T* plane = full.data() + (c % mc) * l.ng;
+                std::copy(plane, plane + l.ng, grid_.data() + c * ng_);
+                if (l.ng == 1) grid_[c * ng_ + 1] = plane[0];
+            }
+            c_equidistant_ = equidistant(angles_c_, l.dc);
+            g_equidistant_ = equidistant(angles_g_, l.dg);
+            inv_dc_ = c_equidistant_ ? 1 / l.dc : 0;
+            inv_dg_ = g_equidistant_ ? 1 / l.dg : 0;
+#ifdef TINY_LDT_X86
+            // the gathers use 32 bit indices
+            simd_ = c_equidistant_ && g_equidistant_ && grid_.size() <= static_cast<size_t>(std::numeric_limits<int32_t>::max()) &&
+                (std::is_same<T, float>::value || std::is_same<T, double>::value) && cpu_has_avx2();
+#endif
+        }
+
+        // false if the light has no consistent distribution, sample returns 0 then
+        bool valid() const { return !grid_.empty(); }
+
+        // c and gamma in degrees, gamma is clamped to the measured range
+        T sample(T c, const T gamma) const {
+            if (grid_.empty()) return 0;
+            const T c0 = angles_c_[0];
+            c = std::fmod(c - c0, T(360));
+            if (c < 0) c += 360;
+            c += c0;
+            size_t i, j;
+            T tc, tg;
+            locate(angles_c_, c_equidistant_, inv_dc_, c, i, tc);
+            locate(angles_g_, g_equidistant_, inv_dg_, gamma, j, tg);
+            const T* p0 = grid_.data() + i * ng_ + j;
+            const T* p1 = p0 + ng_;
+            const T a = p0[0] + (p0[1] - p0[0]) * tg;
+            const T b = p1[0] + (p1[1] - p1[0]) * tg;
+            return a + (b - a) * tc;
+        }
+
+        // n samples at once, AVX2 gathers 8 floats or 4 doubles per step when both axes are equidistant
+        void evaluate(const T* c, const T* gamma, T* out, const size_t n) const {
+            size_t k = 0;
+#ifdef TINY_LDT_X86
+            if (simd_) k = evaluate_avx2(*this, grid_.data(), c, gamma, out, n);
+#endif
+            for (; k < n; ++k) out[k] = sample(c[k], gamma[k]);
+        }
+
+        // directions (x, y, z) in the luminaire's frame, they need not be normalized:
+        // gamma 0 points down (-z), C 0 along +x and C 90 along +y
+        void evaluate(const T* x, const T* y, const T* z, T* out, const size_t n) const {
+            const size_t block = 256;
+            T c[block];
+            T gamma[block];
+            const T to_degrees = T(180) / T(3.14159265358979323846);
+            for (size_t k = 0; k < n; k += block) {
+                const size_t m = std::min(block, n - k);
+                for (size_t i = 0; i < m; ++i) {
+                    c[i] = std::atan2(y[k + i], x[k + i]) * to_degrees;
+                    gamma[i] = std::atan2(std::sqrt(x[k + i] * x[k + i] + y[k + i] * y[k + i]), -z[k + i]) * to_degrees;
+                }
+                evaluate(c, gamma, out + k, m);
+            }
+        }
+
+    private:
+#ifdef TINY_LDT_X86
+        // the same steps as sample on the equidistant path, returns how many samples were written
+        TINY_LDT_TARGET_AVX2 static size_t evaluate_avx2(const evaluator& e, const float* grid, const float* c, const float* gamma, float* out, const size_t n) {
+            const __m256 c0 = _mm256_set1_ps(static_cast<float>(e.angles_c_[0]));
+            const __m256 g0 = _mm256_set1_ps(static_cast<float>(e.angles_g_[0]));
+            const __m256 inv_dc = _mm256_set1_ps(static_cast<float>(e.inv_dc_));
+            const __m256 inv_dg = _mm256_set1_ps(static_cast<float>(e.inv_dg_));
+            const __m256 turn = _mm256_set1_ps(360.0f);
+            const __m256 inv_turn = _mm256_set1_ps(1.0f / 360.0f);
+            const __m256 zero = _mm256_setzero_ps();
+            const size_t mc = e.angles_c_.size() - 1;
+            const __m256 u_max = _mm256_set1_ps(static_cast<float>(mc));
+            const __m256 v_max = _mm256_set1_ps(static_cast<float>(e.ng_ - 1));
+            const __m256i i_max = _mm256_set1_epi32(static_cast<int>(mc - 1));
+            const __m256i j_max = _mm256_set1_epi32(static_cast<int>(e.ng_ - 2));
+            const __m256i ng = _mm256_set1_epi32(static_cast<int>(e.ng_));
+            const float* next_plane = grid + e.ng_;
+            size_t k = 0;
+            for (; k + 8 <= n; k += 8) {
+                __m256 x = _mm256_sub_ps(_mm256_loadu_ps(c + k), c0);
+                x = _mm256_sub_ps(x, _mm256_mul_ps(turn, _mm256_floor_ps(_mm256_mul_ps(x, inv_turn))));
+                // max first, it returns its second operand for nan
+                const __m256 u = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(x, inv_dc), zero), u_max);
+                const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(gamma + k), g0), inv_dg), zero), v_max);
+                const __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(u), i_max);
+                const __m256i j = _mm256_min_epi32(_mm256_cvttps_epi32(v), j_max);
+                const __m256 tc = _mm256_sub_ps(u, _mm256_cvtepi32_ps(i));
+                const __m256 tg = _mm256_sub_ps(v, _mm256_cvtepi32_ps(j));
+                const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(i, ng), j);
+                const __m256 p00 = _mm256_i32gather_ps(grid, index, 4);
+                const __m256 p01 = _mm256_i32gather_ps(grid + 1, index, 4);
+                const __m256 p10 = _mm256_i32gather_ps(next_plane, index, 4);
+                const __m256 p11 = _mm256_i32gather_ps(next_plane + 1, index, 4);
+                const __m256 a = _mm256_add_ps(p00, _mm256_mul_ps(_mm256_sub_ps(p01, p00), tg));
+                const __m256 b = _mm256_add_ps(p10, _mm256_mul_ps(_mm256_sub_ps(p11, p10), tg));
+                _mm256_storeu_ps(out + k, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), tc)));
+            }
+            return k;
+        }
+
+        TINY_LDT_TARGET_AVX2 static size_t evaluate_avx2(const evaluator& e, const double* grid, const double* c, const double* gamma, double* out, const size_t n) {
+            const __m256d c0 = _mm256_set1_pd(static_cast<double>(e.angles_c_[0]));
+            const __m256d g0 = _mm256_set1_pd(static_cast<double>(e.angles_g_[0]));
+            const __m256d inv_dc = _mm256_set1_pd(static_cast<double>(e.inv_dc_));
+            const __m256d inv_dg = _mm256_set1_pd(static_cast<double>(e.inv_dg_));
+            const __m256d turn = _mm256_set1_pd(360.0);
+            const __m256d inv_turn = _mm256_set1_pd(1.0 / 360.0);
+            const __m256d zero = _mm256_setzero_pd();
+            const size_t mc = e.angles_c_.size() - 1;
+            const __m256d u_max = _mm256_set1_pd(static_cast<double>(mc));
+            const __m256d v_max = _mm256_set1_pd(static_cast<double>(e.ng_ - 1));
+            const __m128i i_max = _mm_set1_epi32(static_cast<int>(mc - 1));
+            const __m128i j_max = _mm_set1_epi32(static_cast<int>(e.ng_ - 2));
+            const __m128i ng = _mm_set1_epi32(static_cast<int>(e.ng_));
+            // the masked gather with a zero source, gcc warns about the undefined source of _mm256_i32gather_pd
+            const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            const double* next_plane = grid + e.ng_;
+            size_t k = 0;
+            for (; k + 4 <= n; k += 4) {
+                __m256d x = _mm256_sub_pd(_mm256_loadu_pd(c + k), c0);
+                x = _mm256_sub_pd(x, _mm256_mul_pd(turn, _mm256_floor_pd(_mm256_mul_pd(x, inv_turn))));
+                const __m256d u = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(x, inv_dc), zero), u_max);
+                const __m256d v = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(gamma + k), g0), inv_dg), zero), v_max);
+                const __m128i i = _mm_min_epi32(_mm256_cvttpd_epi32(u), i_max);
+                const __m128i j = _mm_min_epi32(_mm256_cvttpd_epi32(v), j_max);
+                const __m256d tc = _mm256_sub_pd(u, _mm256_cvtepi32_pd(i));
+                const __m256d tg = _mm256_sub_pd(v, _mm256_cvtepi32_pd(j));
+                const __m128i index = _mm_add_epi32(_mm_mullo_epi32(i, ng), j);
+                const __m256d p00 = _mm256_mask_i32gather_pd(zero, grid, index, all, 8);
+                const __m256d p01 = _mm256_mask_i32gather_pd(zero, grid + 1, index, all, 8);
+                const __m256d p10 = _mm256_mask_i32gather_pd(zero, next_plane, index, all, 8);
+                const __m256d p11 = _mm256_mask_i32gather_pd(zero, next_plane + 1, index, all, 8);
+                const __m256d a = _mm256_add_pd(p00, _mm256_mul_pd(_mm256_sub_pd(p01, p00), tg));
+                const __m256d b = _mm256_add_pd(p10, _mm256_mul_pd(_mm256_sub_pd(p11, p10), tg));
+                _mm256_storeu_pd(out + k, _mm256_add_pd(a, _mm256_mul_pd(_mm256_sub_pd(b, a), tc)));
+            }
+            return k;
+        }
+
+        // other floating point types stay scalar
+        template <typename U>
+        static size_t evaluate_avx2(const evaluator&, const U*, const U*, const U*, U*, size_t) { return 0; }
+#endif
+
+        // step matches every angle, within a small fraction of the step
+        static bool equidistant(const vector_type<T>& angles, const T step) {
+            if (!(step > 0)) return false;
+            for (size_t i = 0; i < angles.size(); ++i) {
+                if (std::abs(angles[i] - (angles[0] + static_cast<T>(i) * step)) > step * T(1e-4)) return false;
+            }
+            return true;
+        }
+
+        // cell i (angles[i] <= x <= angles[i + 1]) and the weight of angles[i + 1], x outside is clamped
+        static void locate(const vector_type<T>& angles, const bool equidistant, const T inv_step, const T x, size_t& i, T& t) {
+            const size_t last = angles.size() - 2;
+            if (!(x > angles[0])) {
+                i = 0;
+                t = 0;
+                return;
+            }
+            if (x >= angles[last + 1]) {
+                i = last;
+                t = 1;
+                return;
+            }
+            if (equidistant) {
+                const T u = (x - angles[0]) * inv_step;
+                i = std::min(static_cast<size_t>(u), last);
+                t = std::min(u - static_cast<T>(i), T(1));
+                return;
+            }
+            i = std::min(static_cast<size_t>(std::upper_bound(angles.begin(), angles.end(), x) - angles.begin()) - 1, last);
+            const T width = angles[i + 1] - angles[i];
+            t = width > 0 ? (x - angles[i]) / width : 0;
+        }
+
+        vector_type<T> grid_;       /* (mc + 1) * ng intensities, plane after plane */
+        vector_type<T> angles_c_;   /* mc + 1 */
+        vector_type<T> angles_g_;
+        size_t ng_;
+        bool c_equidistant_;
+        bool g_equidistant_;
+        bool simd_;
+        T inv_dc_;
+        T inv_dg_;
+    };
+
+    // precision 0 writes the shortest numbers that read back to the same values, e.g. 0.1f as 0.1.
+    // any other precision writes floating point values like printf %.<precision>g
+    struct write_options {
+        write_options() : precision(0), threads(1), compress_symmetry(false), symmetry_tolerance(0) {}
+
+        uint32_t precision;     /* 0 = shortest round trip, otherwise printf %.<precision>g */
+        unsigned threads;       /* formatting threads for the intensities (line 30), 0 = hardware concurrency */
+        bool compress_symmetry; /* write with the tightest symmetry found by detect_symmetry */
+        T symmetry_tolerance;   /* relative to the peak intensity */
+
+        // smaller distributions are not worth a thread
+        static const size_t min_values_per_thread = 16384;
+    };
+
+    // with more than one thread the intensities are formatted concurrently into one buffer per thread,
+    // the buffers are written with a single writev where available
+    static bool write_ldt(const std::string& filename, const light& ldt, const write_options& options) {
+        if (options.compress_symmetry) {
+            light compressed(ldt);
+            compress_symmetry(compressed, options.symmetry_tolerance);
+            write_options rest(options);
+            rest.compress_symmetry = false;
+            return write_ldt(filename, compressed, rest);
+        }
+        if (options.threads == 1) return write_ldt(filename, ldt, options.precision);
+        const std::vector<std::string> parts = format_parts(ldt, options);
+#ifdef TINY_LDT_MMAP
+        const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) return false;
+        const bool ok = write_fd(fd, parts);
+        return ::close(fd) == 0 && ok;
+#else
+        std::FILE* file = std::fopen(filename.c_str(), "w");
+        if (!file) return false;
+        bool ok = true;
+        for (const std::string& part : parts) ok = ok && std::fwrite(part.data(), 1, part.size(), file) == part.size();
+        return std::fclose(file) == 0 && ok;
+#endif
+    }
+
+    static bool write_ldt(std::ostream& os, const light& ldt, const write_options& options) {
+        if (options.compress_symmetry) {
+            light compressed(ldt);
+            compress_symmetry(compressed, options.symmetry_tolerance);
+            write_options rest(options);
+            rest.compress_symmetry = false;
+            return write_ldt(os, compressed, rest);
+        }
+        if (options.threads == 1) return write_ldt(os, ldt, options.precision);
+        for (const std::string& part : format_parts(ldt, options)) os.write(part.data(), static_cast<std::streamsize>(part.size()));
+        return static_cast<bool>(os);
+    }
+
+    // the file is written in blocks of write_block_size bytes as they are formatted, memory use does not grow with the distribution
+    static bool write_ldt(const std::string& filename, const light& ldt, const uint32_t precision = 0) {
+#ifdef TINY_LDT_MMAP
+        const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) return false;
+        const bool ok = write_ldt_chunked([fd](const char* data, const size_t size) { return write_fd(fd, data, size); }, ldt, precision);
+        return ::close(fd) == 0 && ok;
+#else
+        std::FILE* file = std::fopen(filename.c_str(), "w");
+        if (!file) return false;
+        // the blocks are buffered already
+        std::setvbuf(file, nullptr, _IONBF, 0);
+        const bool ok = write_ldt_chunked([file](const char* data, const size_t size) { return std::fwrite(data, 1, size, file) == size; }, ldt, precision);
+        return std::fclose(file) == 0 && ok;
+#endif
+    }
+
+    static bool write_ldt(std::ostream& os, const light& ldt, const uint32_t precision = 0) {
+        return write_ldt_chunked([&os](const char* data, const size_t size) {
+            os.write(data, static_cast<std::streamsize>(size));
+            return static_cast<bool>(os);
+        }, ldt, precision);
+    }
+
+    // hands the output to write(const char* data, size_t size) in blocks of at most write_block_size bytes,
+    // write returns false to stop. nothing is allocated
+    template <typename Callback>
+    static bool write_ldt_chunked(Callback write, const light& ldt, const uint32_t precision = 0) {
+        block_sink<Callback> sink(write);
+        write_lines(sink, ldt, precision);
+        return sink.flush();
+    }
+
+    static const size_t write_block_size = 32 * 1024;
+
+    // exact number of bytes written for ldt, formats every value without storing it
+    static size_t write_ldt_size(const light& ldt, const uint32_t precision = 0) {
+        counting_sink sink;
+        write_lines(sink, ldt, precision);
+        return sink.size;
+    }
+
+    // replaces the content of out, which is allocated once with the exact size
+    static void write_ldt_to_memory(std::string& out, const light& ldt, const uint32_t precision = 0) {
+        out.resize(write_ldt_size(ldt, precision));
+        pointer_sink sink(&out[0]);
+        write_lines(sink, ldt, precision);
+    }
+
+    static void write_ldt_to_memory(std::vector<char>& out, const light& ldt, const uint32_t precision = 0) {
+        out.resize(write_ldt_size(ldt, precision));
+        pointer_sink sink(out.data());
+        write_lines(sink, ldt, precision);
+    }
+
+private:
+    enum parse_status { parse_ok, parse_invalid, parse_out_of_range };
+
+    // splits a buffer into lines without copying, handles \n and \r\n line endings
+    struct line_reader {
+        line_reader(const char* data, const size_t size) : cur(data), end(data + size) {}
+
+        bool next(const char*& b, const char*& e) {
+            if (cur == end) return false;
+            const char* nl = static_cast<const char*>(std::memchr(cur, '\n', static_cast<size_t>(end - cur)));
+            b = cur;
+            e = nl ? nl : end;
+            cur = nl ? nl + 1 : end;
+            if (e != b && e[-1] == '\r') --e;
+            return true;
+        }
+
+        const char* cur;
+        const char* end;
+    };
+
+    struct work_range {
+        work_range() : begin(0), end(0) {}
+
+        std::mutex mutex;
+        size_t begin;
+        size_t end;
+    };
+
+    static void batch_worker(const std::vector<std::string>& paths, std::vector<batch_result>& results, std::vector<work_range>& ranges, const unsigned self, const load_limits& limits, const Alloc& alloc) {
+        loader l(limits, alloc);
+        size_t i;
+        while (next_work(ranges, self, i)) {
+            batch_result& r = results[i];
+            r.ok = l.load(paths[i], r.diagnostics, r.ldt);
+        }
+    }
+
+    // takes the next index of the own range, or steals the upper half of the first non empty range of another worker
+    static bool next_work(std::vector<work_range>& ranges, const unsigned self, size_t& index) {
+        work_range& own = ranges[self];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.begin < own.end) {
+                index = own.begin++;
+                return true;
+            }
+        }
+        const size_t count = ranges.size();
+        for (size_t k = 1; k < count; ++k) {
+            work_range& victim = ranges[(self + k) % count];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.begin >= victim.end) continue;
+                end = victim.end;
+                begin = end - (end - victim.begin + 1) / 2;
+                victim.end = begin;
+            }
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = begin + 1;
+            own.end = end;
+            index = begin;
+            return true;
+        }
+        return false;
+    }
+
+    static const std::string& memory_source() {
+        static const std::string source("memory");
+        return source;
+    }
+
+    // state shared by the functions parsing one input, offsets of reported lines are base_offset + (line - base)
+    struct parse_context {
+        parse_context(std::vector<diagnostic>& diagnostics_out, const load_limits& load_limits, const char* data) :
+            diagnostics(diagnostics_out), limits(load_limits), base(data), base_offset(0), remaining(std::numeric_limits<size_t>::max()) {}
+
+        std::vector<diagnostic>& diagnostics;
+        const load_limits& limits;
+        const char* base;
+        size_t base_offset;
+        size_t remaining; /* bytes behind the current line, unknown for streams */
+    };
+
+    static void report(parse_context& ctx, const diagnostic_code code, const field f, const size_t index, const char* at, const light& l) {
+        diagnostic d;
+        d.offset = ctx.base_offset + static_cast<size_t>(at - ctx.base);
+        d.line = line_number(f, index, l);
+        d.field_id = f;
+        d.code = code;
+        d.severity = code < diagnostic_missing_line ? severity_warning : severity_error;
+        ctx.diagnostics.push_back(d);
+    }
+
+    static void report_value(parse_context& ctx, const parse_status status, const field f, const size_t index, const char* at, const light& l) {
+        report(ctx, status == parse_out_of_range ? diagnostic_out_of_range : diagnostic_invalid_value, f, index, at, l);
+    }
+
+    static diagnostic read_failed() {
+        diagnostic d;
+        d.code = diagnostic_read_failed;
+        d.severity = severity_error;
+        return d;
+    }
+
+    // 1 based line of a field, derived from the header counts so it also holds for resumed and streamed input
+    static uint32_t line_number(const field f, const size_t index, const light& l) {
+        if (f <= field_n) return static_cast<uint32_t>(f) + 1;
+        size_t line = field_n + 2;
+        for (size_t g = field_number_of_lamps; g < f; ++g) line += field_count(static_cast<field>(g), l);
+        return static_cast<uint32_t>(line + index);
+    }
+
+    // the former err/warn interface: first error with the source appended, one generic warning
+    static void to_err_warn(const std::vector<diagnostic>& diagnostics, const std::string& source, std::string& err_out, std::string& warn_out) {
+        bool error = false;
+        for (const diagnostic& d : diagnostics) {
+            if (d.severity == severity_warning) warn_out = "Some values could not be read";
+            else if (!error) {
+                err_out = diagnostic_message(d) + ": " + source;
+                error = true;
+            }
+        }
+    }
+
+    static bool parse_ldt(const char* data, const size_t size, parse_context& ctx, light& ldt_out) {
+        clear(ldt_out);
+        if (!check_input_size(size, ctx, ldt_out)) return false;
+        line_reader reader(data, size);
+        field_cursor cursor;
+        return parse_fields(reader, cursor, field_end, ctx, ldt_out);
+    }
+
+    static bool parse_ldt_header(const char* data, const size_t size, parse_context& ctx, light& ldt_out, size_t* data_offset) {
+        clear(ldt_out);
+        if (!check_input_size(size, ctx, ldt_out)) return false;
+        line_reader reader(data, size);
+        field_cursor cursor;
+        if (!parse_fields(reader, cursor, field_angles_c, ctx, ldt_out)) return false;
+        if (data_offset) *data_offset = static_cast<size_t>(reader.cur - data);
+        return true;
+    }
+
+    static bool parse_lazy(const char* data, const size_t size, parse_context& ctx, const std::string& source, lazy_light& ldt_out) {
+        ldt_out = lazy_light(ldt_out.light_.get_allocator());
+        if (!parse_ldt_header(data, size, ctx, ldt_out.light_, &ldt_out.data_offset_)) return false;
+        ldt_out.data_ = data;
+        ldt_out.size_ = size;
+        ldt_out.source_ = source;
+        ldt_out.limits_ = ctx.limits;
+        ldt_out.pending_ = true;
+        return true;
+    }
+
+    // header into scratch, then one allocation sized by it. the values are decoded straight into the arena
+    static bool parse_arena(const char* data, const size_t size, parse_context& ctx, light& scratch, arena_light& ldt_out) {
+        line_reader reader(data, size);
+        if (!parse_sized_header(data, size, ctx, scratch, reader)) return false;
+        ldt_out.assign_header(scratch);
+        return parse_values_into(reader, ctx, scratch, ldt_out.values_);
+    }
+
+    static bool parse_pool(const char* data, const size_t size, parse_context& ctx, light& scratch, light_pool& pool) {
+        line_reader reader(data, size);
+        if (!parse_sized_header(data, size, ctx, scratch, reader)) return false;
+        const size_t index = pool.size();
+        if (parse_values_into(reader, ctx, scratch, pool.append_header(scratch))) return true;
+        pool.truncate(index);
+        return false;
+    }
+
+    // lines 1 - 27 into scratch with the sizes of lines 28 - 30 checked, reader is left at line 28
+    static bool parse_sized_header(const char* data, const size_t size, parse_context& ctx, light& scratch, line_reader& reader) {
+        size_t data_offset = 0;
+        if (!parse_ldt_header(data, size, ctx, scratch, &data_offset)) return false;
+        reader = line_reader(data + data_offset, size - data_offset);
+        ctx.remaining = size - data_offset;
+        return check_values(field_angles_c, reader.cur, ctx, scratch);
+    }
+
+    // decodes lines 28 - 30 into out: angles c, angles g and intensities in a row
+    static bool parse_values_into(line_reader& reader, parse_context& ctx, const light& header, T* out) {
+        field_cursor cursor;
+        enter_field(cursor, field_angles_c, header);
+        while (cursor.f != field_end) {
+            T* values = out + (cursor.f == field_angles_c ? 0 : cursor.f == field_angles_g ? header.mc : header.mc + header.ng);
+            if (!parse_value_lines(reader, cursor, values, field_count(cursor.f, header), ctx, header)) {
+                report(ctx, diagnostic_missing_line, cursor.f, cursor.index, reader.end, header);
+                return false;
+            }
+            next_field(cursor, header);
+        }
+        return true;
+    }
+
+    // lines 28 - 30, needs mc, mc1, mc2 and ng from the header
+    static bool parse_ldt_data(const char* data, const size_t size, const size_t data_offset, parse_context& ctx, light& ldt_out) {
+        if (!check_input_size(size, ctx, ldt_out)) return false;
+        if (data_offset > size) {
+            report(ctx, diagnostic_invalid_offset, field_angles_c, 0, data + size, ldt_out);
+            return false;
+        }
+        line_reader reader(data + data_offset, size - data_offset);
+        field_cursor cursor;
+        enter_field(cursor, field_angles_c, ldt_out);
+        return parse_fields(reader, cursor, field_end, ctx, ldt_out);
+    }
+
+    // parses lines until the cursor reaches until, value blocks (lines 28 - 30) are decoded in batches
+    static bool parse_fields(line_reader& reader, field_cursor& cursor, const field until, parse_context& ctx, light& ldt_out) {
+        const char* b = nullptr;
+        const char* e = nullptr;
+        while (cursor.f < until) {
+            ctx.remaining = static_cast<size_t>(reader.end - reader.cur);
+            if (field_values(cursor.f, ldt_out)) {
+                if (cursor.index == 0 && !prepare_values(cursor.f, reader.cur, ctx, ldt_out)) return false;
+                vector_type<T>& values = *field_values(cursor.f, ldt_out);
+                if (!parse_value_lines(reader, cursor, values.data(), values.size(), ctx, ldt_out)) break;
+                next_field(cursor, ldt_out);
+                continue;
+            }
+            if (!reader.next(b, e)) break;
+            ctx.remaining = static_cast<size_t>(reader.end - reader.cur);
+            if (!parse_field(cursor, b, e, ctx, ldt_out)) return false;
+        }
+        if (cursor.f < until) {
+            report(ctx, diagnostic_missing_line, cursor.f, cursor.index, reader.end, ldt_out);
+            return false;
+        }
+        return true;
+    }
+
+    // parses a single line at the cursor and advances it, returns false if the rest of the file cannot be interpreted
+    static bool parse_field(field_cursor& cursor, const char* b, const char* e, parse_context& ctx, light& l) {
+        if (cursor.index == 0 && field_values(cursor.f, l) && !prepare_values(cursor.f, b, ctx, l)) return false;
+        parse_status status = parse_ok;
+        switch (cursor.f) {
+        /* line  1 */ case field_manufacturer: l.manufacturer.assign(b, e); break;
+        /* line  2 */ case field_ltyp: status = convertToType(b, e, l.ltyp); break;
+        /* line  3 */ case field_lsym: status = convertToType(b, e, l.lsym);
+            if (calc_mc1_mc2(l)) {
+                report(ctx, diagnostic_invalid_symmetry, field_lsym, 0, b, l);
+                return false;
+            }
+            break;
+        /* line  4 */ case field_mc: status = convertToType(b, e, l.mc);
+            if (!check_count(ctx, field_mc, l.mc, ctx.limits.max_c_planes, b, l)) return false;
+            calc_mc1_mc2(l);
+            break;
+        /* line  5 */ case field_dc: status = convertToType(b, e, l.dc); break;
+        /* line  6 */ case field_ng: status = convertToType(b, e, l.ng);
+            if (!check_count(ctx, field_ng, l.ng, ctx.limits.max_gamma_angles, b, l)) return false;
+            break;
+        /* line  7 */ case field_dg: status = convertToType(b, e, l.dg); break;
+
+        /* line  8 */ case field_measurement_report_number: l.measurement_report_number.assign(b, e); break;
+        /* line  9 */ case field_luminaire_name: l.luminaire_name.assign(b, e); break;
+        /* line 10 */ case field_luminaire_number: l.luminaire_number.assign(b, e); break;
+        /* line 11 */ case field_file_name: l.file_name.assign(b, e); break;
+        /* line 12 */ case field_date_user: l.date_user.assign(b, e); break;
+
+        /* line 13 */ case field_length_luminaire: status = convertToType(b, e, l.length_luminaire); break;
+        /* line 14 */ case field_width_luminaire: status = convertToType(b, e, l.width_luminaire); break;
+        /* line 15 */ case field_height_luminaire: status = convertToType(b, e, l.height_luminaire); break;
+        /* line 16 */ case field_length_luminous_area: status = convertToType(b, e, l.length_luminous_area); break;
+        /* line 17 */ case field_width_luminous_area: status = convertToType(b, e, l.width_luminous_area); break;
+        /* line 18 */ case field_height_luminous_area_c0: status = convertToType(b, e, l.height_luminous_area_c0); break;
+        /* line 19 */ case field_height_luminous_area_c90: status = convertToType(b, e, l.height_luminous_area_c90); break;
+        /* line 20 */ case field_height_luminous_area_c180: status = convertToType(b, e, l.height_luminous_area_c180); break;
+        /* line 21 */ case field_height_luminous_area_c270: status = convertToType(b, e, l.height_luminous_area_c270); break;
+        /* line 22 */ case field_dff: status = convertToType(b, e, l.dff); break;
+        /* line 23 */ case field_lorl: status = convertToType(b, e, l.lorl); break;
+        /* line 24 */ case field_conversion_factor: status = convertToType(b, e, l.conversion_factor); break;
+        /* line 25 */ case field_tilt_of_luminaire: status = convertToType(b, e, l.tilt_of_luminaire); break;
+        /* line 26 */ case field_n: status = convertToType(b, e, l.n);
+            if (!check_lamp_sets(ctx, b, l)) return false;
+            resize_lamp_data(l, l.n);
+            break;
+
+        // for each in the file defined lamp
+        /* line 26a */ case field_number_of_lamps: status = convertToType(b, e, l.lamp_data[cursor.index].number_of_lamps); break;
+        /* line 26b */ case field_type_of_lamps: l.lamp_data[cursor.index].type_of_lamps.assign(b, e); break;
+        /* line 26c */ case field_total_luminous_flux: status = convertToType(b, e, l.lamp_data[cursor.index].total_luminous_flux); break;
+        /* line 26d */ case field_color_temperature: status = convertToType(b, e, l.lamp_data[cursor.index].color_temperature); break;
+        /* line 26e */ case field_color_rendering_group: status = convertToType(b, e, l.lamp_data[cursor.index].color_rendering_group); break;
+        /* line 26f */ case field_watt: status = convertToType(b, e, l.lamp_data[cursor.index].watt); break;
+        /* line 27 */ case field_dr: status = convertToType(b, e, l.dr[cursor.index]); break;
+        /* line 28 */ case field_angles_c: status = convertToType(b, e, l.angles_c[cursor.index]); break;
+        /* line 29 */ case field_angles_g: status = convertToType(b, e, l.angles_g[cursor.index]); break;
+        /* line 30 */ case field_luminous_intensity_distribution: status = convertToType(b, e, l.luminous_intensity_distribution[cursor.index]); break;
+        case field_end: return true;
+        }
+        if (status != parse_ok) report_value(ctx, status, cursor.f, cursor.index, b, l);
+        if (++cursor.index >= field_count(cursor.f, l)) next_field(cursor, l);
+        return true;
+    }
+
+    static void next_field(field_cursor& cursor, const light& l) {
+        enter_field(cursor, static_cast<field>(cursor.f + 1), l);
+    }
+
+    // moves the cursor to the first line of f, skipping repeated fields that are empty for this light
+    static void enter_field(field_cursor& cursor, const field f, const light& l) {
+        cursor.f = f;
+        cursor.index = 0;
+        while (cursor.f != field_end && field_count(cursor.f, l) == 0) cursor.f = static_cast<field>(cursor.f + 1);
+    }
+
+    // number of lines of a field, repeated fields are sized by the header values read before them
+    static size_t field_count(const field f, const light& l) {
+        switch (f) {
+        case field_number_of_lamps:
+        case field_type_of_lamps:
+        case field_total_luminous_flux:
+        case field_color_temperature:
+        case field_color_rendering_group:
+        case field_watt: return l.n;
+        case field_dr: return l.dr.size();
+        case field_angles_c: return l.mc;
+        case field_angles_g: return l.ng;
+        case field_luminous_intensity_distribution: return intensity_count(l);
+        case field_end: return 0;
+        default: return 1;
+        }
+    }
+
+    // the fields made of one value per line that are worth decoding in batches
+    static vector_type<T>* field_values(const field f, light& l) {
+        switch (f) {
+        case field_angles_c: return &l.angles_c;
+        case field_angles_g: return &l.angles_g;
+        case field_luminous_intensity_distribution: return &l.luminous_intensity_distribution;
+        default: return nullptr;
+        }
+    }
+
+    // allocates a value block right before its first line, after checking the declared sizes
+    static bool prepare_values(const field f, const char* at, parse_context& ctx, light& l) {
+        if (!check_values(f, at, ctx, l)) return false;
+        field_values(f, l)->resize(field_count(f, l));
+        return true;
+    }
+
+    static bool check_input_size(const size_t size, parse_context& ctx, const light& l) {
+        if (size <= ctx.limits.max_total_bytes) return true;
+        report(ctx, diagnostic_input_too_large, field_manufacturer, 0, ctx.base, l);
+        return false;
+    }
+
+    // every line takes at least one byte, so a count larger than the remaining input cannot be valid
+    static bool check_lamp_sets(parse_context& ctx, const char* at, const light& l) {
+        if (l.n > ctx.limits.max_lamp_sets) {
+            report(ctx, diagnostic_limit_exceeded, field_n, 0, at, l);
+            return false;
+        }
+        if (static_cast<uint64_t>(l.n) * 6 + l.dr.size() > ctx.remaining) {
+            report(ctx, diagnostic_input_too_short, field_n, 0, at, l);
+            return false;
+        }
+        return true;
+    }
+
+    // mc and ng are checked on their own lines (4 and 6)
+    static bool check_count(parse_context& ctx, const field f, const uint32_t count, const uint32_t limit, const char* at, const light& l) {
+        if (count <= limit) return true;
+        report(ctx, diagnostic_limit_exceeded, f, 0, at, l);
+        return false;
+    }
+
+    // reported at the first line of the block f, at. the counts are checked again for headers parsed by an earlier call
+    static bool check_values(const field f, const char* at, parse_context& ctx, const light& l) {
+        const uint64_t intensities = static_cast<uint64_t>(intensity_count(l));
+        const uint64_t values = static_cast<uint64_t>(l.mc) + l.ng + intensities;
+        if (l.mc > ctx.limits.max_c_planes || l.ng > ctx.limits.max_gamma_angles || values > ctx.limits.max_total_bytes / sizeof(T)) {
+            report(ctx, diagnostic_limit_exceeded, f, 0, at, l);
+            return false;
+        }
+        const uint64_t lines = f == field_angles_c ? values : f == field_angles_g ? l.ng + intensities : intensities;
+        if (lines > ctx.remaining) {
+            report(ctx, diagnostic_input_too_short, f, 0, at, l);
+            return false;
+        }
+        return true;
+    }
+
+    // 30 ((Mc2 - Mc1 + 1) * Ng)
+    // if lsym 0 : mc1 = 1, mc2 = mc
+    // if lsym 1 : mc1 = 1, mc2 = 1
+    // if lsym 2 : mc1 = 1, mc2 = mc / 2 + 1
+    // if lsym 3 : mc1 = 3 * mc / 4 + 1, mc2 = mc1 + mc / 2
+    // if lsym 4 : mc1 = 1, mc2 = mc / 4 + 1
+    static size_t intensity_count(const light& l) {
+        return (static_cast<size_t>(l.mc2) - static_cast<size_t>(l.mc1) + 1) * static_cast<size_t>(l.ng);
+    }
+
+    // decodes the remaining lines of the value block at the cursor into out[0, count), returns false if the input ends early
+    static bool parse_value_lines(line_reader& reader, field_cursor& cursor, T* out, const size_t count, parse_context& ctx, const light& l) {
+        while (cursor.index < count) {
+            if (parse_value_batch(reader.cur, reader.end, cursor, out, count, ctx, l) == 0) {
+                // last line without a trailing newline
+                const char* b = nullptr;
+                const char* e = nullptr;
+                if (!reader.next(b, e)) return false;
+                const parse_status status = convertToType(b, e, out[cursor.index]);
+                if (status != parse_ok) report_value(ctx, status, cursor.f, cursor.index, b, l);
+                ++cursor.index;
+            }
+        }
+        return true;
+    }
+
+    // decodes complete lines of the value block at the cursor starting at p into out[0, count), line ends are located in batches by find_newlines
+    // p and the cursor index are moved behind the last decoded line, returns the number of decoded values
+    static size_t parse_value_batch(const char*& p, const char* end, field_cursor& cursor, T* out, const size_t count, parse_context& ctx, const light& l) {
+        const size_t batch = 256;
+        const char* ends[batch];
+        const char* cur = p;
+        size_t i = cursor.index;
+        while (i < count) {
+            const size_t found = find_newlines(cur, end, ends, std::min(batch, count - i));
+            for (size_t j = 0; j < found; ++j, ++i) {
+                const parse_status status = convertToType(cur, ends[j], out[i]);
+                if (status != parse_ok) report_value(ctx, status, cursor.f, i, cur, l);
+                cur = ends[j] + 1;
+            }
+            if (found < batch) break;
+        }
+        const size_t decoded = i - cursor.index;
+        cursor.index = i;
+        p = cur;
+        return decoded;
+    }
+
+    typedef size_t (*find_newlines_fn)(const char*, const char*, const char**, size_t);
+
+    // stores the positions of up to max '\n' in [p, end) in out and returns how many were found
+    static size_t find_newlines(const char* p, const char* end, const char** out, const size_t max) {
+        static const find_newlines_fn fn = select_find_newlines();
+        return fn(p, end, out, max);
+    }
+
+    static size_t find_newlines_scalar(const char* p, const char* end, const char** out, const size_t max) {
+        size_t n = 0;
+        while (n < max && p != end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!nl) break;
+            out[n++] = nl;
+            p = nl + 1;
+        }
+        return n;
+    }
+
+#ifdef TINY_LDT_X86
+    static uint32_t count_trailing_zeros(const uint32_t mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    static size_t find_newlines_sse2(const char* p, const char* end, const char** out, const size_t max) {
+        const __m128i nl = _mm_set1_epi8('\n');
+        size_t n = 0;
+        for (; n < max && end - p >= 16; p += 16) {
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), nl)));
+            for (; mask; mask &= mask - 1) {
+                out[n++] = p + count_trailing_zeros(mask);
+                if (n == max) return n;
+            }
+        }
+        return n + find_newlines_scalar(p, end, out + n, max - n);
+    }
+
+    TINY_LDT_TARGET_AVX2 static size_t find_newlines_avx2(const char* p, const char* end, const char** out, const size_t max) {
+        const __m256i nl = _mm256_set1_epi8('\n');
+        size_t n = 0;
+        for (; n < max && end - p >= 32; p += 32) {
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), nl)));
+            for (; mask; mask &= mask - 1) {
+                out[n++] = p + count_trailing_zeros(mask);
+                if (n == max) return n;
+            }
+        }
+        return n + find_newlines_scalar(p, end, out + n, max - n);
+    }
+
+    static bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7) return false;
+        __cpuid(regs, 1);
+        // the os has to save the ymm registers
+        if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(regs, 7, 0);
+        return (regs[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    static find_newlines_fn select_find_newlines() {
+#ifdef TINY_LDT_X86
+        if (cpu_has_avx2()) return &find_newlines_avx2;
+        return &find_newlines_sse2;
+#else
+        return &find_newlines_scalar;
+#endif
+    }
+
+    // the destination type selects the parser at compile time, integer fields never go through floating point
+    static parse_status convertToType(const char* b, const char* e, uint32_t& out) { return parse_integer(b, e, out); }
+    static parse_status convertToType(const char* b, const char* e, int& out) { return parse_integer(b, e, out); }
+    static parse_status convertToType(const char* b, const char* e, float& out) { return parse_floating(b, e, out); }
+    static parse_status convertToType(const char* b, const char* e, double& out) { return parse_floating(b, e, out); }
+
+    static bool is_digit(const char c) { return static_cast<unsigned>(c - '0') < 10u; }
+
+    static const char* skip_space(const char* b, const char* e) {
+        while (b != e && (*b == ' ' || *b == '\t' || *b == '\r' || *b == '\v' || *b == '\f')) ++b;
+        return b;
+    }
+
+    // accepts [ws][+|-]digits[(.|,)digits][(e|E)[+|-]digits], the fraction is truncated like the former float conversion did
+    template <typename U>
+    static parse_status parse_integer(const char* b, const char* e, U& out) {
+        static_assert(std::is_integral<U>::value, "U must be integral");
+        b = skip_space(b, e);
+        const char* const number = b;
+        bool negative = false;
+        if (b != e && (*b == '+' || *b == '-')) negative = *b++ == '-';
+
+        const uint64_t limit = negative ? (std::is_signed<U>::value ? static_cast<uint64_t>(std::numeric_limits<U>::max()) + 1 : 0)
+            : static_cast<uint64_t>(std::numeric_limits<U>::max());
+        uint64_t v = 0;
+        bool any = false;
+        bool overflow = false;
+        for (; b != e && is_digit(*b); ++b) {
+            any = true;
+            const uint64_t d = static_cast<uint64_t>(*b - '0');
+            if (v > (limit - d) / 10) overflow = true;
+            else v = v * 10 + d;
+        }
+        if (!any && b != e && (*b == '.' || *b == ',')) any = b + 1 != e && is_digit(b[1]);
+        if (!any) return parse_invalid;
+
+        // an exponent (e.g. "1e3") takes the floating point path and the truncated value is range checked
+        const char* p = b;
+        if (p != e && (*p == '.' || *p == ',')) {
+            for (++p; p != e && is_digit(*p); ++p) {}
+        }
+        if (p != e && (*p == 'e' || *p == 'E')) {
+            double d;
+            const parse_status status = parse_decimal(number, e, d);
+            if (status != parse_ok) return status;
+            d = std::trunc(d);
+            if (d < static_cast<double>(std::numeric_limits<U>::min()) || d > static_cast<double>(std::numeric_limits<U>::max())) return parse_out_of_range;
+            out = static_cast<U>(d);
+            return parse_ok;
+        }
+
+        if (overflow || v > limit) return parse_out_of_range;
+        out = negative ? static_cast<U>(-static_cast<int64_t>(v)) : static_cast<U>(v);
+        return parse_ok;
+    }
+
+    template <typename U>
+    static parse_status parse_floating(const char* b, const char* e, U& out) {
+        double v;
+        const parse_status status = parse_decimal(b, e, v);
+        if (status != parse_ok) return status;
+        const U u = static_cast<U>(v);
+        if (std::isinf(u) || (u == 0 && v != 0)) return parse_out_of_range;
+        out = u;
+        return parse_ok;
+    }
+
+    // locale independent replacement for strtod that reports errors instead of throwing
+    // accepts [ws][+|-]digits[(.|,)digits][(e|E)[+|-]digits], trailing characters are ignored like in std::stod
+    static parse_status parse_decimal(const char* b, const char* e, double& out) {
+        b = skip_space(b, e);
+        bool negative = false;
+        if (b != e && (*b == '+' || *b == '-')) negative = *b++ == '-';
+
+        // up to 19 significant digits fit into the mantissa, the rest only shifts the exponent
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool any = false;
+        for (; b != e && is_digit(*b); ++b) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*b - '0');
+                if (mantissa) ++digits;
+            }
+            else ++exponent;
+        }
+        if (b != e && (*b == '.' || *b == ',')) {
+            for (++b; b != e && is_digit(*b); ++b) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*b - '0');
+                    if (mantissa) ++digits;
+                    --exponent;
+                }
+            }
+        }
+        if (!any) return parse_invalid;
+        if (b != e && (*b == 'e' || *b == 'E')) {
+            const char* p = b + 1;
+            bool negative_exponent = false;
+            if (p != e && (*p == '+' || *p == '-')) negative_exponent = *p++ == '-';
+            int x = 0;
+            for (; p != e && is_digit(*p); ++p) {
+                if (x < 100000) x = x * 10 + (*p - '0');
+            }
+            exponent += negative_exponent ? -x : x;
+        }
+
+        if (mantissa == 0) {
+            out = negative ? -0.0 : 0.0;
+            return parse_ok;
+        }
+        double v;
+        if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            // both operands are exact, so a single rounding gives the correctly rounded result
+            static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+            v = static_cast<double>(mantissa);
+            v = exponent < 0 ? v / pow10[-exponent] : v * pow10[exponent];
+        }
+        else {
+            // rare in ldt files, strtod rounds correctly. the rebuilt text has no decimal point, so the locale does not matter
+            char buf[48];
+            std::snprintf(buf, sizeof(buf), "%llue%d", static_cast<unsigned long long>(mantissa), exponent);
+            v = std::strtod(buf, nullptr);
+        }
+        if (v == 0 || std::isinf(v)) return parse_out_of_range;
+        out = negative ? -v : v;
+        return parse_ok;
+    }
+
+    // the sinks write_lines writes to, put(data, size) receives every byte of the output in order
+    struct counting_sink {
+        counting_sink() : size(0) {}
+        void put(const char*, const size_t n) { size += n; }
+        size_t size;
+    };
+
+    // writes to a buffer known to be large enough
+    struct pointer_sink {
+        explicit pointer_sink(char* out) : cur(out) {}
+        void put(const char* data, const size_t n) {
+            std::memcpy(cur, data, n);
+            cur += n;
+        }
+        char* cur;
+    };
+
+    template <typename Callback>
+    struct block_sink {
+        explicit block_sink(Callback& callback) : write(callback), used(0), ok(true) {}
+
+        void put(const char* data, size_t n) {
+            while (n) {
+                const size_t k = std::min(n, buffer.size() - used);
+                std::memcpy(buffer.data() + used, data, k);
+                used += k;
+                data += k;
+                n -= k;
+                if (used == buffer.size()) flush();
+            }
+        }
+
+        // returns false once a write failed, everything after that is dropped
+        bool flush() {
+            if (ok && used) ok = write(buffer.data(), used);
+            used = 0;
+            return ok;
+        }
+
+        Callback& write;
+        std::array<char, write_block_size> buffer;
+        size_t used;
+        bool ok;
+    };
+
+#ifdef TINY_LDT_MMAP
+    static bool write_fd(const int fd, const char* data, size_t size) {
+        while (size) {
+            const ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+#endif
+
+    template <typename Sink>
+    static void write_lines(Sink& sink, const light& ldt, const uint32_t precision, const bool intensities = true) {
+        /* line  1 */ put_line(sink, ldt.manufacturer, precision);
+        /* line  2 */ put_line(sink, ldt.ltyp, precision);
+        /* line  3 */ put_line(sink, ldt.lsym, precision);
+        /* line  4 */ put_line(sink, ldt.mc, precision);
+        /* line  5 */ put_line(sink, ldt.dc, precision);
+        /* line  6 */ put_line(sink, ldt.ng, precision);
+        /* line  7 */ put_line(sink, ldt.dg, precision);
+
+        /* line  8 */ put_line(sink, ldt.measurement_report_number, precision);
+        /* line  9 */ put_line(sink, ldt.luminaire_name, precision);
+        /* line 10 */ put_line(sink, ldt.luminaire_number, precision);
+        /* line 11 */ put_line(sink, ldt.file_name, precision);
+        /* line 12 */ put_line(sink, ldt.date_user, precision);
+
+        /* line 13 */ put_line(sink, ldt.length_luminaire, precision);
+        /* line 14 */ put_line(sink, ldt.width_luminaire, precision);
+        /* line 15 */ put_line(sink, ldt.height_luminaire, precision);
+        /* line 16 */ put_line(sink, ldt.length_luminous_area, precision);
+        /* line 17 */ put_line(sink, ldt.width_luminous_area, precision);
+        /* line 18 */ put_line(sink, ldt.height_luminous_area_c0, precision);
+        /* line 19 */ put_line(sink, ldt.height_luminous_area_c90, precision);
+        /* line 20 */ put_line(sink, ldt.height_luminous_area_c180, precision);
+        /* line 21 */ put_line(sink, ldt.height_luminous_area_c270, precision);
+        /* line 22 */ put_line(sink, ldt.dff, precision);
+        /* line 23 */ put_line(sink, ldt.lorl, precision);
+        /* line 24 */ put_line(sink, ldt.conversion_factor, precision);
+        /* line 25 */ put_line(sink, ldt.tilt_of_luminaire, precision);
+        /* line 26 */ put_line(sink, ldt.n, precision);
+
+        // for each in the file defined lamp
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26a */ put_line(sink, ld.number_of_lamps, precision);
+        }
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26b */ put_line(sink, ld.type_of_lamps, precision);
+        }
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26c */ put_line(sink, ld.total_luminous_flux, precision);
+        }
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26d */ put_line(sink, ld.color_temperature, precision);
+        }
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26e */ put_line(sink, ld.color_rendering_group, precision);
+        }
+        for (const auto& ld : ldt.lamp_data) {
+            /* line 26f */ put_line(sink, ld.watt, precision);
+        }
+        for (const T& v : ldt.dr) {
+            /* line 27 */ put_line(sink, v, precision);
+        }
+        for (const T& v : ldt.angles_c) {
+            /* line 28 */ put_line(sink, v, precision);
+        }
+        for (const T& v : ldt.angles_g) {
+            /* line 29 */ put_line(sink, v, precision);
+        }
+        if (intensities) write_intensity_lines(sink, ldt, 0, ldt.luminous_intensity_distribution.size(), precision);
+    }
+
+    template <typename Sink>
+    static void write_intensity_lines(Sink& sink, const light& ldt, const size_t begin, const size_t end, const uint32_t precision) {
+        for (size_t i = begin; i < end; ++i) {
+            /* line 30 */ put_line(sink, ldt.luminous_intensity_distribution[i], precision);
+        }
+    }
+
+    struct string_sink {
+        explicit string_sink(std::string& s) : out(s) {}
+        void put(const char* data, const size_t n) { out.append(data, n); }
+        std::string& out;
+    };
+
+    // lines 1 - 29 go into the first part, the intensities are split evenly over the others and formatted concurrently
+    static std::vector<std::string> format_parts(const light& ldt, const write_options& options) {
+        const size_t count = ldt.luminous_intensity_distribution.size();
+        unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count / write_options::min_values_per_thread)));
+        std::vector<std::string> parts(threads + 1);
+        string_sink head(parts[0]);
+        write_lines(head, ldt, options.precision, false);
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (unsigned w = 1; w < threads; ++w) workers.emplace_back(format_part, std::cref(ldt), std::ref(parts[w + 1]), count * w / threads, count * (w + 1) / threads, options.precision);
+        format_part(ldt, parts[1], 0, count / threads, options.precision);
+        for (std::thread& t : workers) t.join();
+        return parts;
+    }
+
+    static void format_part(const light& ldt, std::string& out, const size_t begin, const size_t end, const uint32_t precision) {
+        out.reserve((end - begin) * 12);
+        string_sink sink(out);
+        write_intensity_lines(sink, ldt, begin, end, precision);
+    }
+
+#ifdef TINY_LDT_MMAP
+    // writes all parts with as few system calls as possible, continues after partial writes
+    static bool write_fd(const int fd, const std::vector<std::string>& parts) {
+        std::vector<struct iovec> iov;
+        for (const std::string& part : parts) {
+            if (part.empty()) continue;
+            struct iovec v;
+            v.iov_base = const_cast<char*>(part.data());
+            v.iov_len = part.size();
+            iov.push_back(v);
+        }
+        size_t i = 0;
+        while (i < iov.size()) {
+            const ssize_t n = ::writev(fd, &iov[i], static_cast<int>(std::min<size_t>(iov.size() - i, IOV_MAX)));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            size_t written = static_cast<size_t>(n);
+            while (i < iov.size() && written >= iov[i].iov_len) written -= iov[i++].iov_len;
+            if (written) {
+                iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + written;
+                iov[i].iov_len -= written;
+            }
+        }
+        return true;
+    }
+#endif
+
+    template <typename Sink>
+    static void put_line(Sink& sink, const string_type& v, uint32_t) {
+        sink.put(v.data(), v.size());
+        sink.put("\n", 1);
+    }
+
+    template <typename Sink, typename U>
+    static void put_line(Sink& sink, const U v, const uint32_t precision) {
+        char buf[max_number_length];
+        char* end = format_value(buf, v, precision);
+        *end++ = '\n';
+        sink.put(buf, static_cast<size_t>(end - buf));
+    }
+
+    // number formatting for write_ldt, every function writes into a caller provided buffer and returns the end
+    static char* format_integer(char* out, const uint64_t v) {
+        char tmp[20];
+        size_t n = 0;
+        uint64_t x = v;
+        do {
+            tmp[n++] = static_cast<char>('0' + x % 10);
+            x /= 10;
+        } while (x);
+        while (n) *out++ = tmp[--n];
+        return out;
+    }
+
+    static char* format_value(char* out, const uint32_t v, uint32_t) { return format_integer(out, v); }
+
+    static char* format_value(char* out, const int v, uint32_t) {
+        if (v < 0) *out++ = '-';
+        return format_integer(out, v < 0 ? 0 - static_cast<uint64_t>(static_cast<int64_t>(v)) : static_cast<uint64_t>(v));
+    }
+
+    // precision 0 writes the shortest digits that read back to the same value, otherwise like printf %.<precision>g
+    template <typename U>
+    static char* format_value(char* out, const U v, const uint32_t precision) {
+        if (precision) {
+            // snprintf follows the C locale, the decimal point is the only character it can change
+            const int n = std::snprintf(out, max_number_length, "%.*g", static_cast<int>(std::min<uint32_t>(precision, max_number_length - 8)), static_cast<double>(v));
+            char* end = out + std::max(0, std::min(n, static_cast<int>(max_number_length) - 1));
+            for (char* c = out; c != end; ++c) {
+                if (*c == ',') *c = '.';
+            }
+            return end;
+        }
+        if (std::isnan(v)) return copy_literal(out, "nan");
+        if (std::signbit(v)) *out++ = '-';
+        if (std::isinf(v)) return copy_literal(out, "inf");
+        if (v == 0) {
+            *out++ = '0';
+            return out;
+        }
+        char digits[20];
+        int length = 0;
+        int exponent = 0;
+        grisu2(digits, length, exponent, std::abs(v));
+        return format_digits(out, digits, length, exponent, std::numeric_limits<U>::max_digits10);
+    }
+
+    // large enough for any value written by format_value
+    static const size_t max_number_length = 64;
+
+    static char* copy_literal(char* out, const char* s) {
+        while (*s) *out++ = *s++;
+        return out;
+    }
+
+    // writes digits * 10^exponent like %g would: fixed notation unless the decimal exponent is below -4 or not below max_exponent
+    static char* format_digits(char* out, const char* digits, const int length, const int exponent, const int max_exponent) {
+        const int point = length + exponent; /* position of the decimal point relative to the first digit */
+        if (point - 1 < -4 || point - 1 >= max_exponent) {
+            *out++ = digits[0];
+            if (length > 1) {
+                *out++ = '.';
+                out = std::copy(digits + 1, digits + length, out);
+            }
+            int e = point - 1;
+            *out++ = 'e';
+            *out++ = e < 0 ? '-' : '+';
+            if (e < 0) e = -e;
+            if (e < 10) *out++ = '0';
+            return format_integer(out, static_cast<uint64_t>(e));
+        }
+        if (point <= 0) {
+            *out++ = '0';
+            *out++ = '.';
+            out = std::fill_n(out, -point, '0');
+            return std::copy(digits, digits + length, out);
+        }
+        if (point >= length) {
+            out = std::copy(digits, digits + length, out);
+            return std::fill_n(out, point - length, '0');
+        }
+        out = std::copy(digits, digits + point, out);
+        *out++ = '.';
+        return std::copy(digits + point, digits + length, out);
+    }
+
+    // Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers") with the boundary
+    // handling of Milo Yip's and nlohmann's implementations. the digits always read back to v and are the shortest
+    // possible for all but a tiny fraction of values, where one more digit is written
+    struct diy_fp {
+        diy_fp(const uint64_t f_, const int e_) : f(f_), e(e_) {}
+        uint64_t f;
+        int e;
+    };
+
+    static diy_fp diy_sub(const diy_fp& x, const diy_fp& y) { return diy_fp(x.f - y.f, x.e); }
+
+    // upper 64 bits of the 128 bit product, rounded
+    static diy_fp diy_mul(const diy_fp& x, const diy_fp& y) {
+        const uint64_t x_lo = x.f & 0xFFFFFFFFu, x_hi = x.f >> 32;
+        const uint64_t y_lo = y.f & 0xFFFFFFFFu, y_hi = y.f >> 32;
+        const uint64_t p0 = x_lo * y_lo, p1 = x_lo * y_hi, p2 = x_hi * y_lo, p3 = x_hi * y_hi;
+        uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+        q += uint64_t(1) << 31;
+        return diy_fp(p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32), x.e + y.e + 64);
+    }
+
+    static diy_fp diy_normalize(diy_fp x) {
+        while ((x.f >> 63) == 0) {
+            x.f <<= 1;
+            --x.e;
+        }
+        return x;
+    }
+
+    // v and its rounding boundaries, normalized to the same exponent. v is finite and positive
+    template <typename U>
+    static void boundaries(const U v, diy_fp& w, diy_fp& w_minus, diy_fp& w_plus) {
+        typedef typename std::conditional<sizeof(U) == 8, uint64_t, uint32_t>::type bits_type;
+        const int precision = std::numeric_limits<U>::digits; /* including the hidden bit */
+        const int bias = std::numeric_limits<U>::max_exponent - 1 + (precision - 1);
+        const uint64_t hidden_bit = uint64_t(1) << (precision - 1);
+        bits_type bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        const uint64_t e = static_cast<uint64_t>(bits) >> (precision - 1);
+        const uint64_t f = static_cast<uint64_t>(bits) & (hidden_bit - 1);
+        const diy_fp x = e == 0 ? diy_fp(f, 1 - bias) : diy_fp(f + hidden_bit, static_cast<int>(e) - bias);
+        // the lower boundary is closer if v is a power of two, except for the smallest normal value
+        const bool lower_closer = f == 0 && e > 1;
+        const diy_fp m_plus(2 * x.f + 1, x.e - 1);
+        const diy_fp m_minus = lower_closer ? diy_fp(4 * x.f - 1, x.e - 2) : diy_fp(2 * x.f - 1, x.e - 1);
+        w_plus = diy_normalize(m_plus);
+        w_minus = diy_fp(m_minus.f << (m_minus.e - w_plus.e), w_plus.e);
+        w = diy_normalize(x);
+    }
+
+    struct cached_power {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    // c = f * 2^e ~= 10^k with the binary exponent of c * w in [-60, -32]
+    static cached_power cached_power_for(const int e) {
+        static const cached_power powers[] = {
+            { 0xAB70FE17C79AC6CA, -1060, -300 }, { 0xFF77B1FCBEBCDC4F, -1034, -292 }, { 0xBE5691EF416BD60C, -1007, -284 },
+            { 0x8DD01FAD907FFC3C, -980, -276 }, { 0xD3515C2831559A83, -954, -268 }, { 0x9D71AC8FADA6C9B5, -927, -260 },
+            { 0xEA9C227723EE8BCB, -901, -252 }, { 0xAECC49914078536D, -874, -244 }, { 0x823C12795DB6CE57, -847, -236 },
+            { 0xC21094364DFB5637, -821, -228 }, { 0x9096EA6F3848984F, -794, -220 }, { 0xD77485CB25823AC7, -768, -212 },
+            { 0xA086CFCD97BF97F4, -741, -204 }, { 0xEF340A98172AACE5, -715, -196 }, { 0xB23867FB2A35B28E, -688, -188 },
+            { 0x84C8D4DFD2C63F3B, -661, -180 }, { 0xC5DD44271AD3CDBA, -635, -172 }, { 0x936B9FCEBB25C996, -608, -164 },
+            { 0xDBAC6C247D62A584, -582, -156 }, { 0xA3AB66580D5FDAF6, -555, -148 }, { 0xF3E2F893DEC3F126, -529, -140 },
+            { 0xB5B5ADA8AAFF80B8, -502, -132 }, { 0x87625F056C7C4A8B, -475, -124 }, { 0xC9BCFF6034C13053, -449, -116 },
+            { 0x964E858C91BA2655, -422, -108 }, { 0xDFF9772470297EBD, -396, -100 }, { 0xA6DFBD9FB8E5B88F, -369, -92 },
+            { 0xF8A95FCF88747D94, -343, -84 }, { 0xB94470938FA89BCF, -316, -76 }, { 0x8A08F0F8BF0F156B, -289, -68 },
+            { 0xCDB02555653131B6, -263, -60 }, { 0x993FE2C6D07B7FAC, -236, -52 }, { 0xE45C10C42A2B3B06, -210, -44 },
+            { 0xAA242499697392D3, -183, -36 }, { 0xFD87B5F28300CA0E, -157, -28 }, { 0xBCE5086492111AEB, -130, -20 },
+            { 0x8CBCCC096F5088CC, -103, -12 }, { 0xD1B71758E219652C, -77, -4 }, { 0x9C40000000000000, -50, 4 },
+            { 0xE8D4A51000000000, -24, 12 }, { 0xAD78EBC5AC620000, 3, 20 }, { 0x813F3978F8940984, 30, 28 },
+            { 0xC097CE7BC90715B3, 56, 36 }, { 0x8F7E32CE7BEA5C70, 83, 44 }, { 0xD5D238A4ABE98068, 109, 52 },
+            { 0x9F4F2726179A2245, 136, 60 }, { 0xED63A231D4C4FB27, 162, 68 }, { 0xB0DE65388CC8ADA8, 189, 76 },
+            { 0x83C7088E1AAB65DB, 216, 84 }, { 0xC45D1DF942711D9A, 242, 92 }, { 0x924D692CA61BE758, 269, 100 },
+            { 0xDA01EE641A708DEA, 295, 108 }, { 0xA26DA3999AEF774A, 322, 116 }, { 0xF209787BB47D6B85, 348, 124 },
+            { 0xB454E4A179DD1877, 375, 132 }, { 0x865B86925B9BC5C2, 402, 140 }, { 0xC83553C5C8965D3D, 428, 148 },
+            { 0x952AB45CFA97A0B3, 455, 156 }, { 0xDE469FBD99A05FE3, 481, 164 }, { 0xA59BC234DB398C25, 508, 172 },
+            { 0xF6C69A72A3989F5C, 534, 180 }, { 0xB7DCBF5354E9BECE, 561, 188 }, { 0x88FCF317F22241E2, 588, 196 },
+            { 0xCC20CE9BD35C78A5, 614, 204 }, { 0x98165AF37B2153DF, 641, 212 }, { 0xE2A0B5DC971F303A, 667, 220 },
+            { 0xA8D9D1535CE3B396, 694, 228 }, { 0xFB9B7CD9A4A7443C, 720, 236 }, { 0xBB764C4CA7A44410, 747, 244 },
+            { 0x8BAB8EEFB6409C1A, 774, 252 }, { 0xD01FEF10A657842C, 800, 260 }, { 0x9B10A4E5E9913129, 827, 268 },
+            { 0xE7109BFBA19C0C9D, 853, 276 }, { 0xAC2820D9623BF429, 880, 284 }, { 0x80444B5E7AA7CF85, 907, 292 },
+            { 0xBF21E44003ACDD2D, 933, 300 }, { 0x8E679C2F5E44FF8F, 960, 308 }, { 0xD433179D9C8CB841, 986, 316 },
+            { 0x9E19DB92B4E31BA9, 1013, 324 }
+        };
+        const int f = -60 - e - 1;
+        const int k = (f * 78913) / (1 << 18) + (f > 0);
+        return powers[static_cast<size_t>(300 + k + 7) / 8];
+    }
+
+    static void grisu2_round(char* digits, const int length, const uint64_t dist, const uint64_t delta, uint64_t rest, const uint64_t ten_k) {
+        while (rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+            --digits[length - 1];
+            rest += ten_k;
+        }
+    }
+
+    template <typename U>
+    static void grisu2(char* digits, int& length, int& exponent, const U v) {
+        diy_fp w(0, 0), w_minus(0, 0), w_plus(0, 0);
+        boundaries(v, w, w_minus, w_plus);
+        const cached_power c = cached_power_for(w_plus.e);
+        const diy_fp c_minus_k(c.f, c.e);
+        const diy_fp scaled = diy_mul(w, c_minus_k);
+        const diy_fp lower = diy_mul(w_minus, c_minus_k);
+        const diy_fp upper = diy_mul(w_plus, c_minus_k);
+        // shrink the interval by one unit on each side to stay safely inside the rounding range
+        const diy_fp m_minus(lower.f + 1, lower.e);
+        const diy_fp m_plus(upper.f - 1, upper.e);
+        exponent = -c.k;
+        length = 0;
+
+        uint64_t delta = diy_sub(m_plus, m_minus).f;
+        uint64_t dist = diy_sub(m_plus, scaled).f;
+        const diy_fp one(uint64_t(1) << -m_plus.e, m_plus.e);
+        uint32_t p1 = static_cast<uint32_t>(m_plus.f >> -one.e);
+        uint64_t p2 = m_plus.f & (one.f - 1);
+
+        uint32_t pow10 = 1000000000;
+        int n = 10;
+        while (n > 1 && p1 < pow10) {
+            pow10 /= 10;
+            --n;
+        }
+        // integral part
+        while (n > 0) {
+            digits[length++] = static_cast<char>('0' + p1 / pow10);
+            p1 %= pow10;
+            --n;
+            const uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+            if (rest <= delta) {
+                exponent += n;
+                grisu2_round(digits, length, dist, delta, rest, static_cast<uint64_t>(pow10) << -one.e);
+                return;
+            }
+            pow10 /= 10;
+        }
+        // fractional part
+        int m = 0;
+        for (;;) {
+            p2 *= 10;
+            digits[length++] = static_cast<char>('0' + (p2 >> -one.e));
+            p2 &= one.f - 1;
+            ++m;
+            delta *= 10;
+            dist *= 10;
+            if (p2 <= delta) break;
+        }
+        exponent -= m;
+        grisu2_round(digits, length, dist, delta, p2, one.f);
+    }
+
+    // the intensities match the header and mc can be split by the symmetry (even for lsym 2, a multiple of 4 for lsym 3 and 4)
+    static bool symmetry_valid(const light& l) {
+        if (l.lsym > 4 || l.luminous_intensity_distribution.size() != intensity_count(l)) return false;
+        // mc 0 still counts one stored plane for lsym 1 - 4 (mc2 = mc1 = 1)
+        if (l.lsym != 0 && l.mc == 0) return false;
+        return !((l.lsym == 2 && l.mc % 2) || ((l.lsym == 3 || l.lsym == 4) && l.mc % 4));
+    }
+
+    // full plane that plane c is mirrored from when storing with lsym
+    static size_t source_plane(const uint32_t lsym, const size_t mc, const size_t c) {
+        switch (lsym) {
+        case 1: return 0;
+        case 2: return intensity_view<2>(nullptr, mc, 0).stored_plane(c);
+        case 3: return (intensity_view<3>(nullptr, mc, 0).stored_plane(c) + 3 * (mc / 4)) % mc;
+        case 4: return intensity_view<4>(nullptr, mc, 0).stored_plane(c);
+        default: return c;
+        }
+    }
+
+    static bool symmetry_holds(const light& l, const vector_type<T>& full, const uint32_t lsym, const T limit) {
+        const size_t mc = l.mc;
+        const size_t ng = l.ng;
+        if ((lsym == 2 && mc % 2) || ((lsym == 3 || lsym == 4) && mc % 4)) return false;
+        if (lsym != 1 && l.angles_c.size() != mc) return false;
+        for (size_t c = 0; c < mc; ++c) {
+            const size_t p = source_plane(lsym, mc, c);
+            if (p == c) continue;
+            if (lsym != 1 && !mirrored_angle(lsym, l.angles_c[c], l.angles_c[p])) return false;
+            for (size_t g = 0; g < ng; ++g) {
+                if (!(std::abs(full[c * ng + g] - full[p * ng + g]) <= limit)) return false;
+            }
+        }
+        return true;
+    }
+
+    // b is one of the images of a under the mirror planes of lsym (degrees)
+    static bool mirrored_angle(const uint32_t lsym, const T a, const T b) {
+        const bool c0 = lsym == 2 || lsym == 4;     /* mirror plane C0 - C180: a -> 360 - a */
+        const bool c90 = lsym == 3 || lsym == 4;    /* mirror plane C90 - C270: a -> 180 - a */
+        return same_angle(a, b) || (c0 && same_angle(360 - a, b)) || (c90 && same_angle(180 - a, b)) || (c0 && c90 && same_angle(180 + a, b));
+    }
+
+    static bool same_angle(const T a, const T b) {
+        T d = std::fmod(std::abs(a - b), T(360));
+        return std::min(d, 360 - d) <= T(1e-3);
+    }
+
+    // copies count planes of ng values starting at stored plane from to full plane to
+    static void copy_planes(const T* in, const size_t from, T* out, const size_t to, const size_t count, const size_t ng) {
+        if (count && ng) std::memcpy(out + to * ng, in + from * ng, count * ng * sizeof(T));
+    }
+
+    // IEEE 754 binary16 conversion, rounds to nearest even
+    static uint16_t to_half(const float f) {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+        const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+        x &= 0x7FFFFFFFu;
+        if (x >= 0x7F800000u) return static_cast<uint16_t>(sign | 0x7C00u | (x > 0x7F800000u ? 0x200u : 0u)); /* inf, nan */
+        if (x >= 0x477FF000u) return static_cast<uint16_t>(sign | 0x7C00u); /* rounds above the largest half */
+        if (x < 0x38800000u) {
+            // subnormal half, h * 2^-24
+            if (x < 0x33000000u) return sign;
+            const uint32_t shift = 126 - (x >> 23);
+            const uint32_t m = (x & 0x7FFFFFu) | 0x800000u;
+            uint32_t h = m >> shift;
+            const uint32_t rest = m & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (h & 1u))) ++h;
+            return static_cast<uint16_t>(sign | h);
+        }
+        uint32_t h = (x - 0x38000000u) >> 13;
+        const uint32_t rest = x & 0x1FFFu;
+        if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) ++h;
+        return static_cast<uint16_t>(sign | h);
+    }
+
+    static float from_half(const uint16_t h) {
+        const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+        const uint32_t e = (h >> 10) & 0x1Fu;
+        const uint32_t m = h & 0x3FFu;
+        uint32_t x;
+        if (e == 0) {
+            const float v = static_cast<float>(m) * (1.0f / 16777216.0f);
+            return sign ? -v : v;
+        }
+        if (e == 31) x = sign | 0x7F800000u | (m << 13);
+        else x = sign | ((e + 112) << 23) | (m << 13);
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
     }
 
     static bool calc_mc1_mc2(light& l) {